@@ -4,10 +4,14 @@
 #include <iterator>
 #include <cstddef>
 
+#include "Memory.h"
+
 /*
  * Each chunk now is 8 bytes long (from 24),
  * and the method can handle up to 2^32-2 ~ 4.3 billion input points
  * (if there is enough RAM of course).
+ * The points of a chunk are a linked list in the index list of the structure that owns it,
+ * which is passed to addIndex and points, so several structures can live side by side.
  */
 
 using Integer = std::uint_fast32_t;
@@ -17,7 +21,6 @@ class Chunk
 {
 	Integer startIndex_{ maxValue };
 	Integer endIndex_{ maxValue };
-	static inline std::vector<Integer>* indicesPtr_{ nullptr };
 
 	struct Iterator
 	{
@@ -27,8 +30,8 @@ class Chunk
 		using pointer = value_type*;
 		using reference = value_type&;
 
-		explicit Iterator(const value_type& index) :
-			index_{ index }
+		Iterator(const value_type& index, const HugeVector<Integer>* indices) :
+			index_{ index }, indices_{ indices }
 		{}
 
 		const value_type& operator*() const noexcept
@@ -38,7 +41,7 @@ class Chunk
 
 		Iterator& operator++() noexcept
 		{
-			index_ = (*indicesPtr_)[index_];
+			index_ = (*indices_)[index_];
 			return *this;
 		}
 
@@ -49,28 +52,44 @@ class Chunk
 			return tmp;
 		}
 
-		friend bool operator== (const Iterator& a, const Iterator& b) = default;
+		friend bool operator== (const Iterator& a, const Iterator& b) noexcept
+		{
+			return a.index_ == b.index_;
+		}
 
 	private:
 
 		value_type index_;
+		const HugeVector<Integer>* indices_;
+	};
+
+	/* The points of a chunk, linked through the index list of the structure that owns the chunk. */
+	struct Points
+	{
+		Integer startIndex;
+		const HugeVector<Integer>* indices;
+
+		Iterator begin() const noexcept
+		{
+			return Iterator(startIndex, indices);
+		}
+
+		Iterator end() const noexcept
+		{
+			return Iterator(maxValue, indices);
+		}
 	};
 
 public:
 
 	Chunk() = default;
 
-	static void setIndices(std::vector<Integer>& indices) noexcept
-	{
-		indicesPtr_ = &indices;
-	}
-
 	bool isEmpty(void) const noexcept
 	{
 		return startIndex_ == maxValue;
 	}
 
-	void addIndex(const Integer index) noexcept
+	void addIndex(const Integer index, HugeVector<Integer>& indices) noexcept
 	{
 		if (startIndex_ == maxValue)
 		{
@@ -78,27 +97,22 @@ public:
 			return;
 		}
 
-		(*indicesPtr_)[endIndex_] = index;
+		indices[endIndex_] = index;
 		endIndex_ = index;
 	}
 
-	size_t size() const noexcept
+	size_t size(const HugeVector<Integer>& indices) const noexcept
 	{
 		size_t size = 0;
 
-		for (auto currentIndex{ startIndex_ }; currentIndex != endIndex_; currentIndex = (*indicesPtr_)[currentIndex])
+		for (auto currentIndex{ startIndex_ }; currentIndex != maxValue; currentIndex = indices[currentIndex])
 			++size;
 
 		return size;
 	}
 
-	Iterator begin() const noexcept
-	{
-		return Iterator(startIndex_);
-	}
-
-	Iterator end() const noexcept
+	Points points(const HugeVector<Integer>& indices) const noexcept
 	{
-		return Iterator(maxValue);
+		return { startIndex_, &indices };
 	}
 };
\ No newline at end of file
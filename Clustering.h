@@ -1,26 +1,94 @@
 #pragma once
 
 #include "SpatialStruct.h"
+#include "Sharding.h"
+#include "Ingest.h"
+#include "VariableRadius.h"
+#include "Snapshot.h"
 
 namespace Radius2DClustering
 {
+	template<class Metric = Euclidean>
 	Integer scaleCluster2DPoints(std::vector<Point> Points, const double scale, const bool stableCC = false, const bool verbose = false)
 	{
-		SpatialStruct spatial(Points, scale, verbose);
+		SpatialStruct<Metric> spatial(Points, scale, verbose);
 		return spatial.computeClusters(stableCC);
 	}
 
+	template<class Metric = Euclidean>
 	std::set<std::set<Integer>> getScaleCluster2DPoints(std::vector<Point> Points, const double scale, const bool stableCC = false, const bool verbose = false)
 	{
-		SpatialStruct spatial(Points, scale, verbose);
+		SpatialStruct<Metric> spatial(Points, scale, verbose);
 		auto clusters = spatial.computeClusters(stableCC);
 		return spatial.getClusters();
 	}
 
+	template<class Metric = Euclidean>
 	void printScaleCluster2DPoints(std::vector<Point> Points, const double scale, const bool stableCC = false, const bool verbose = false, std::ostream& outStream = std::cout)
 	{
-		SpatialStruct spatial(Points, scale, verbose);
+		SpatialStruct<Metric> spatial(Points, scale, verbose);
 		auto clusters = spatial.computeClusters(stableCC);
 		spatial.printClusters(outStream);
 	}
+
+	template<class Metric = Euclidean>
+	ClusterEstimate approximateScaleCluster2DPoints(std::vector<Point> Points, const double scale, const Integer samples = 10'000, 
+													const double confidence = 0.95, const bool verbose = false)
+	{
+		SpatialStruct<Metric> spatial(Points, scale, verbose);
+		return spatial.estimateClusters(samples, confidence);
+	}
+
+	template<class Metric = Euclidean>
+	Integer adaptiveScaleCluster2DPoints(std::vector<Point> Points, const double scale, const bool verbose = false)
+	{
+		SpatialStruct<Metric> spatial(Points, scale, Engine::Adaptive, verbose);
+		return spatial.computeClusters();
+	}
+
+	template<class Metric = Euclidean>
+	std::vector<MatchPair> crossMatch2DPoints(const std::vector<Point>& A, std::vector<Point> B, const double scale, const bool verbose = false)
+	{
+		SpatialStruct<Metric> spatial(B, scale, verbose);
+		return spatial.crossMatch(A);
+	}
+
+	template<class Metric = Euclidean>
+	std::vector<Integer> crossMatchLabels2DPoints(const std::vector<Point>& A, std::vector<Point> B, const double scale, const bool verbose = false)
+	{
+		SpatialStruct<Metric> spatial(B, scale, verbose);
+		spatial.computeClusters();
+		return spatial.crossMatchLabels(A);
+	}
+
+	Integer shardedScaleCluster2DPoints(std::vector<Point> Points, const double scale, const Integer tilesX, const Integer tilesY, 
+										const Integer maxWorkers, const bool stableCC = false, const bool verbose = false)
+	{
+		ForkSocketTransport transport;
+		ShardedClustering sharded(Points, scale, transport, tilesX, tilesY, maxWorkers, verbose);
+		return sharded.computeClusters(stableCC);
+	}
+
+	Integer pipelinedScaleCluster2DFiles(const std::vector<std::string>& files, const double scale, const bool stableCC = false, const bool verbose = false)
+	{
+		PipelinedIngest ingest(files, scale, verbose);
+		return ingest.computeClusters(stableCC);
+	}
+
+	/*
+	 * With the bounds of every point, each block is bucketed while the next ones are read,
+	 * and with y-ordered files (see Ingest.h) the completed strips are merged during the reading too.
+	 */
+	Integer pipelinedScaleCluster2DFiles(const std::vector<std::string>& files, const double scale, const Bounds& bounds, const bool yOrdered = false,
+										 const bool stableCC = false, const bool verbose = false)
+	{
+		PipelinedIngest ingest(files, scale, bounds, yOrdered, verbose);
+		return ingest.computeClusters(stableCC);
+	}
+
+	Integer variableRadiusCluster2DPoints(std::vector<Point> Points, std::vector<double> Radii, const LinkRule rule = LinkRule::Sum, const bool verbose = false)
+	{
+		VariableRadiusStruct spatial(Points, Radii, rule, verbose);
+		return spatial.computeClusters();
+	}
 }
@@ -0,0 +1,461 @@
+#include <condition_variable>
+#include <stop_token>
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <format>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define RADIUS_2D_HAS_IO_URING
+#endif
+
+#include "Ingest.h"
+
+static_assert(std::is_trivially_copyable_v<Point> && sizeof(Point) == 2 * sizeof(double), "Points are read as raw bytes.");
+
+namespace
+{
+	bool readFully(const BlockRead& read)
+	{
+		auto* current{ static_cast<char*>(read.destination) };
+		auto offset{ static_cast<off_t>(read.offset) };
+
+		for (auto remaining{ read.bytes }; remaining;)
+		{
+			const auto bytes{ ::pread(read.file, current, remaining, offset) };
+
+			if (bytes < 0 && errno == EINTR)
+				continue;
+
+			if (bytes <= 0)
+				return false;
+
+			current += bytes;
+			offset += bytes;
+			remaining -= static_cast<std::size_t>(bytes);
+		}
+
+		return true;
+	}
+
+	class ThreadBlockReader final : public BlockReader
+	{
+	public:
+
+		explicit ThreadBlockReader(const unsigned threads)
+		{
+			threadPool_.reserve(threads);
+
+			for (auto index{ threads }; index--;)
+				threadPool_.emplace_back([this](std::stop_token stop) { readLoop(stop); });
+		}
+
+		bool submit(const BlockRead& read) override
+		{
+			{
+				std::lock_guard lock(mutex_);
+				requests_.push_back(read);
+			}
+
+			requestCondition_.notify_one();
+			return true;
+		}
+
+		Integer complete(void) override
+		{
+			std::unique_lock lock(mutex_);
+			completeCondition_.wait(lock, [this] { return !completed_.empty(); });
+
+			const auto block{ completed_.front() };
+			completed_.pop_front();
+
+			return block;
+		}
+
+	private:
+
+		void readLoop(std::stop_token stop)
+		{
+			while (true)
+			{
+				BlockRead read{};
+				{
+					std::unique_lock lock(mutex_);
+
+					if (!requestCondition_.wait(lock, stop, [this] { return !requests_.empty(); }))
+						return;
+
+					read = requests_.front();
+					requests_.pop_front();
+				}
+
+				const auto block{ readFully(read) ? read.block : maxValue };
+				{
+					std::lock_guard lock(mutex_);
+					completed_.push_back(block);
+				}
+
+				completeCondition_.notify_one();
+			}
+		}
+
+		std::mutex mutex_;
+		std::condition_variable_any requestCondition_;
+		std::condition_variable completeCondition_;
+		std::deque<BlockRead> requests_;
+		std::deque<Integer> completed_;
+		std::vector<std::jthread> threadPool_;
+	};
+
+#ifdef RADIUS_2D_HAS_IO_URING
+	class UringBlockReader final : public BlockReader
+	{
+	public:
+
+		explicit UringBlockReader(const unsigned queueDepth) :
+			inFlight_(queueDepth)
+		{
+			initialized_ = io_uring_queue_init(queueDepth, &ring_, 0) == 0;
+
+			for (auto& read : inFlight_)
+				free_.push_back(&read);
+		}
+
+		~UringBlockReader() override
+		{
+			if (initialized_)
+				io_uring_queue_exit(&ring_);
+		}
+
+		bool isInitialized(void) const noexcept
+		{
+			return initialized_;
+		}
+
+		bool submit(const BlockRead& read) override
+		{
+			if (free_.empty())
+				return false;
+
+			auto* slot{ free_.back() };
+			free_.pop_back();
+			*slot = read;
+
+			return push(slot);
+		}
+
+		Integer complete(void) override
+		{
+			while (true)
+			{
+				io_uring_cqe* cqe{ nullptr };
+
+				if (io_uring_wait_cqe(&ring_, &cqe) < 0)
+					return maxValue;
+
+				auto* slot{ static_cast<BlockRead*>(io_uring_cqe_get_data(cqe)) };
+				const auto bytes{ cqe->res };
+				io_uring_cqe_seen(&ring_, cqe);
+
+				if (bytes <= 0)
+					return maxValue;
+
+				/* Short reads are resubmitted for the rest of the block. */
+				if (static_cast<std::size_t>(bytes) < slot->bytes)
+				{
+					slot->destination = static_cast<char*>(slot->destination) + bytes;
+					slot->offset += static_cast<std::uint64_t>(bytes);
+					slot->bytes -= static_cast<std::size_t>(bytes);
+
+					if (!push(slot))
+						return maxValue;
+
+					continue;
+				}
+
+				free_.push_back(slot);
+				return slot->block;
+			}
+		}
+
+	private:
+
+		bool push(BlockRead* slot)
+		{
+			auto* sqe{ io_uring_get_sqe(&ring_) };
+
+			if (!sqe)
+				return false;
+
+			io_uring_prep_read(sqe, slot->file, slot->destination, static_cast<unsigned>(slot->bytes), slot->offset);
+			io_uring_sqe_set_data(sqe, slot);
+
+			return io_uring_submit(&ring_) >= 0;
+		}
+
+		bool initialized_{ false };
+		io_uring ring_{};
+		std::vector<BlockRead> inFlight_;
+		std::vector<BlockRead*> free_;
+	};
+#endif
+}
+
+std::unique_ptr<BlockReader> makeBlockReader(const unsigned queueDepth)
+{
+#ifdef RADIUS_2D_HAS_IO_URING
+	if (auto reader{ std::make_unique<UringBlockReader>(queueDepth) }; reader->isInitialized())
+		return reader;
+#endif
+
+	return std::make_unique<ThreadBlockReader>(queueDepth);
+}
+
+PipelinedIngest::PipelinedIngest(const std::vector<std::string>& files, const double scale, const bool verbose) :
+	printMessages_{ verbose }, scale_{ scale }, files_{ files } {}
+
+PipelinedIngest::PipelinedIngest(const std::vector<std::string>& files, const double scale, const Bounds& bounds,
+								const bool yOrdered, const bool verbose) :
+	printMessages_{ verbose }, hasBounds_{ true }, yOrdered_{ yOrdered }, scale_{ scale }, bounds_{ bounds }, files_{ files } {}
+
+void PipelinedIngest::printMessage(const std::string_view message) const
+{
+	if (printMessages_)
+		std::cout << "\n" << message << "\n";
+}
+
+bool PipelinedIngest::ingest(void)
+{
+	std::vector<int> descriptors;
+	std::vector<BlockRead> blocks;
+	Integer N{ 0 };
+
+	auto closeFiles = [&descriptors]()
+	{
+		for (const auto descriptor : descriptors)
+			::close(descriptor);
+	};
+
+	for (const auto& file : files_)
+	{
+		const auto descriptor{ ::open(file.c_str(), O_RDONLY) };
+		struct stat status {};
+
+		if (descriptor < 0 || ::fstat(descriptor, &status) < 0 || status.st_size % sizeof(Point))
+		{
+			std::cout << std::format("\nFile {} can't be read or is not a points file. Structure wasn't created...\n", file);
+
+			if (descriptor >= 0)
+				::close(descriptor);
+
+			closeFiles();
+			return false;
+		}
+
+		descriptors.push_back(descriptor);
+
+		const auto filePoints{ static_cast<Integer>(status.st_size / sizeof(Point)) };
+
+		for (Integer first{ 0 }; first < filePoints; first += blockPoints_)
+		{
+			const auto points{ std::min(blockPoints_, filePoints - first) };
+			blocks.push_back({ descriptor, first * sizeof(Point), points * sizeof(Point), nullptr, N + first });
+		}
+
+		N += filePoints;
+	}
+
+	if (!N || N >= maxValue)
+	{
+		std::cout << "\nPoint set is empty or too big. Structure wasn't created...\n";
+		closeFiles();
+		return false;
+	}
+
+	/* Blocks are read in place, so nothing moves afterwards, and the grid can see the whole array. */
+	Points_.resize(N);
+
+	const auto numberOfBlocks{ static_cast<Integer>(blocks.size()) };
+
+	std::vector<Integer> blockEnds(numberOfBlocks);
+	std::vector<Bounds> blockBounds(numberOfBlocks);
+	std::vector<char> blockDone(numberOfBlocks, 0);
+
+	for (Integer block{ 0 }; block < numberOfBlocks; ++block)
+	{
+		blocks[block].destination = Points_.data() + blocks[block].block;
+		blockEnds[block] = blocks[block].block + static_cast<Integer>(blocks[block].bytes / sizeof(Point));
+		blocks[block].block = block;
+	}
+
+	if (hasBounds_)
+		spatial_ = std::make_unique<SpatialStruct<>>(Points_, scale_, bounds_, printMessages_);
+
+	/* Strips of the grid under the watermark are merged by this thread while the rest is arriving. */
+	std::mutex mergeMutex;
+	std::condition_variable_any mergeCondition;
+	double watermark{ minPointValue };
+	bool streamMerge{ hasBounds_ && yOrdered_ };
+
+	std::jthread mergeThread;
+
+	if (streamMerge)
+		mergeThread = std::jthread([&](std::stop_token stop)
+		{
+			double merged{ minPointValue };
+
+			while (true)
+			{
+				{
+					std::unique_lock lock(mergeMutex);
+
+					if (!mergeCondition.wait(lock, stop, [&] { return watermark > merged; }))
+						return;
+
+					merged = watermark;
+				}
+
+				spatial_->mergeBelow(merged);
+			}
+		});
+
+	auto stopMerge = [&]()
+	{
+		if (mergeThread.joinable())
+		{
+			mergeThread.request_stop();
+			mergeThread.join();
+		}
+	};
+
+	auto reader{ makeBlockReader(queueDepth_) };
+
+	Integer submitted{ 0 };
+	Integer nextInOrder{ 0 };
+	bool succeeded{ true };
+
+	for (; submitted < std::min<Integer>(queueDepth_, numberOfBlocks); ++submitted)
+		succeeded = reader->submit(blocks[submitted]) && succeeded;
+
+	for (Integer received{ 0 }; received < submitted && succeeded; ++received)
+	{
+		const auto block{ reader->complete() };
+
+		if (block == maxValue)
+		{
+			succeeded = false;
+			break;
+		}
+
+		if (submitted < numberOfBlocks)
+			succeeded = reader->submit(blocks[submitted++]) && succeeded;
+
+		const auto fromIndex{ static_cast<Integer>(static_cast<const Point*>(blocks[block].destination) - Points_.data()) };
+		const auto toIndex{ blockEnds[block] };
+
+		auto& bounds{ blockBounds[block] };
+
+		for (Integer index{ fromIndex }; index < toIndex; ++index)
+		{
+			const auto& point{ Points_[index] };
+
+			bounds.minX = std::min(bounds.minX, point.x());
+			bounds.maxX = std::max(bounds.maxX, point.x());
+			bounds.minY = std::min(bounds.minY, point.y());
+			bounds.maxY = std::max(bounds.maxY, point.y());
+		}
+
+		blockDone[block] = 1;
+
+		if (!hasBounds_)
+			continue;
+
+		if (bounds.minX < bounds_.minX || bounds.maxX > bounds_.maxX || bounds.minY < bounds_.minY || bounds.maxY > bounds_.maxY)
+		{
+			std::cout << "\nA block has points outside of the given bounds. Structure wasn't created...\n";
+			succeeded = false;
+			break;
+		}
+
+		if (streamMerge && bounds.minY < watermark)
+		{
+			printMessage("Input is not ordered by y, strips will be merged after the ingest.");
+
+			stopMerge();
+			spatial_->restartMerge();
+			streamMerge = false;
+		}
+
+		spatial_->insertPoints(fromIndex, toIndex);
+
+		if (!streamMerge)
+			continue;
+
+		auto newWatermark{ watermark };
+
+		for (; nextInOrder < numberOfBlocks && blockDone[nextInOrder]; ++nextInOrder)
+			newWatermark = std::max(newWatermark, blockBounds[nextInOrder].maxY);
+
+		if (newWatermark > watermark)
+		{
+			{
+				std::lock_guard lock(mergeMutex);
+				watermark = newWatermark;
+			}
+
+			mergeCondition.notify_one();
+		}
+	}
+
+	stopMerge();
+	reader.reset();
+	closeFiles();
+
+	if (!succeeded)
+	{
+		std::cout << "\nReading the point files failed. Structure wasn't created...\n";
+		spatial_.reset();
+		return false;
+	}
+
+	printMessage(std::format("Read {} points in {} blocks.", N, numberOfBlocks));
+
+	if (!hasBounds_)
+	{
+		Bounds bounds{};
+
+		for (const auto& [minX, maxX, minY, maxY] : blockBounds)
+			bounds = { std::min(bounds.minX, minX), std::max(bounds.maxX, maxX), std::min(bounds.minY, minY), std::max(bounds.maxY, maxY) };
+
+		spatial_ = std::make_unique<SpatialStruct<>>(Points_, scale_, bounds, printMessages_);
+		spatial_->insertPoints(0, N);
+	}
+
+	return true;
+}
+
+Integer PipelinedIngest::computeClusters(const bool byXY)
+{
+	if (!spatial_ && !ingest())
+		return 0;
+
+	return spatial_->computeClusters(byXY);
+}
+
+std::set<std::set<Integer>> PipelinedIngest::getClusters(void) const
+{
+	if (!spatial_)
+		return {};
+
+	return spatial_->getClusters();
+}
+
+std::vector<Point>& PipelinedIngest::getPoints(void) noexcept
+{
+	return Points_;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include "SpatialStruct.h"
+
+/*
+ * Pipelined ingest of point files (raw x, y doubles, as in Point).
+ * Blocks are read asynchronously straight into the final points array (io_uring if available,
+ * else a pool of reading threads), and every arrived block is bounded and bucketed into the grid
+ * while the next blocks are still on their way.
+ * With caller bounds and y-ordered input (every point of a block has y at least the maximum y of
+ * the blocks before it, e.g. a declination sweep), the completed strips of the grid are also merged
+ * by another thread during the ingest, so the end-to-end time approaches max(I/O, compute).
+ */
+
+struct BlockRead
+{
+	int file{ -1 };
+	std::uint64_t offset{ 0 };
+	std::size_t bytes{ 0 };
+	void* destination{ nullptr };
+	Integer block{ 0 };
+};
+
+class BlockReader
+{
+public:
+
+	virtual ~BlockReader() = default;
+
+	virtual bool submit(const BlockRead& read) = 0;
+
+	/* Waits for the next completed block, returns maxValue if a read failed. */
+	virtual Integer complete(void) = 0;
+};
+
+/* io_uring reader when liburing is available (link with -luring) and the kernel allows it, else the threaded one. */
+std::unique_ptr<BlockReader> makeBlockReader(const unsigned queueDepth);
+
+class PipelinedIngest
+{
+public:
+
+	PipelinedIngest(const std::vector<std::string>& files, const double scale, const bool verbose = true);
+
+	PipelinedIngest(const std::vector<std::string>& files, const double scale, const Bounds& bounds,
+					const bool yOrdered = false, const bool verbose = true);
+
+	Integer computeClusters(const bool byXY = true);
+
+	std::set<std::set<Integer>> getClusters(void) const;
+
+	std::vector<Point>& getPoints(void) noexcept;
+
+private:
+
+/* Methods */
+
+	void printMessage(const std::string_view message) const;
+
+	bool ingest(void);
+
+/* Fields */
+
+	bool printMessages_{ true };
+	bool hasBounds_{ false };
+	bool yOrdered_{ false };
+
+	double scale_{ 0.0 };
+	Bounds bounds_{};
+
+	static inline const Integer blockPoints_{ 1U << 20 };
+	static inline const unsigned queueDepth_{ 8 };
+
+	std::vector<std::string> files_;
+	std::vector<Point> Points_;
+	std::unique_ptr<SpatialStruct<>> spatial_;
+};
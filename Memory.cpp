@@ -0,0 +1,165 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "Memory.h"
+
+PageArena& PageArena::instance(void)
+{
+	static PageArena arena;
+	return arena;
+}
+
+PageArena::~PageArena()
+{
+	release();
+}
+
+void* PageArena::map(const std::size_t bytes)
+{
+#ifdef _WIN32
+	/* Large pages need the SeLockMemoryPrivilege, without it the first call fails. */
+	if (const auto largePage{ GetLargePageMinimum() }; largePage && bytes % largePage == 0)
+		if (auto* pointer{ VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE) })
+			return pointer;
+
+	return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#ifdef MAP_HUGETLB
+	if (auto* pointer{ mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) }; pointer != MAP_FAILED)
+		return pointer;
+#endif
+
+	auto* pointer{ mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+
+	if (pointer == MAP_FAILED)
+		return nullptr;
+
+#ifdef MADV_HUGEPAGE
+	madvise(pointer, bytes, MADV_HUGEPAGE);
+#endif
+
+	return pointer;
+#endif
+}
+
+void PageArena::unmap(void* pointer, const std::size_t bytes) noexcept
+{
+#ifdef _WIN32
+	VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+	munmap(pointer, bytes);
+#endif
+}
+
+void* PageArena::allocate(const std::size_t bytes)
+{
+	if (bytes < hugePageSize)
+		return ::operator new(bytes);
+
+	const auto size{ (bytes + hugePageSize - 1) / hugePageSize * hugePageSize };
+
+	{
+		std::lock_guard lock(mutex_);
+
+		if (const auto block{ freeBlocks_.lower_bound(size) }; block != freeBlocks_.end())
+		{
+			const auto [blockSize, pointer] = *block;
+
+			freeBlocks_.erase(block);
+			keptBytes_ -= blockSize;
+			usedBlocks_.emplace(pointer, blockSize);
+
+			usedBytes_ += blockSize;
+			peakUsedBytes_ = std::max(peakUsedBytes_, usedBytes_);
+
+			return pointer;
+		}
+	}
+
+	auto* pointer{ map(size) };
+
+	if (!pointer)
+	{
+		/* Out of address space or memory: give the kept blocks back, and try once more. */
+		release();
+
+		pointer = map(size);
+	}
+
+	if (!pointer)
+		throw std::bad_alloc();
+
+	std::lock_guard lock(mutex_);
+	usedBlocks_.emplace(pointer, size);
+
+	mappedBytes_ += size;
+	usedBytes_ += size;
+	peakUsedBytes_ = std::max(peakUsedBytes_, usedBytes_);
+
+	return pointer;
+}
+
+void PageArena::deallocate(void* pointer, const std::size_t bytes) noexcept
+{
+	if (bytes < hugePageSize)
+	{
+		::operator delete(pointer);
+		return;
+	}
+
+	std::lock_guard lock(mutex_);
+
+	const auto block{ usedBlocks_.find(pointer) };
+	const auto size{ block->second };
+
+	usedBlocks_.erase(block);
+	usedBytes_ -= size;
+
+	freeBlocks_.emplace(size, pointer);
+	keptBytes_ += size;
+
+	trim();
+}
+
+void PageArena::trim(void) noexcept
+{
+	const auto limit{ maximumKept_ == automaticKept ? peakUsedBytes_ : maximumKept_ };
+
+	while (keptBytes_ > limit)
+	{
+		const auto block{ freeBlocks_.begin() };
+
+		unmap(block->second, block->first);
+		keptBytes_ -= block->first;
+		freeBlocks_.erase(block);
+	}
+}
+
+void PageArena::setMaximumKept(const std::size_t bytes) noexcept
+{
+	std::lock_guard lock(mutex_);
+
+	maximumKept_ = bytes;
+	trim();
+}
+
+std::size_t PageArena::mappedBytes(void) noexcept
+{
+	std::lock_guard lock(mutex_);
+
+	return mappedBytes_;
+}
+
+void PageArena::release(void) noexcept
+{
+	std::lock_guard lock(mutex_);
+
+	for (const auto& [size, pointer] : freeBlocks_)
+		unmap(pointer, size);
+
+	freeBlocks_.clear();
+	keptBytes_ = 0;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Memory of the big working arrays (indices, parents, chunks).
+ *
+ * Blocks of at least hugePageSize bytes are mapped directly, backed by huge pages when the system gives them
+ * (MAP_HUGETLB, then transparent huge pages with madvise, then plain pages), so the TLB isn't thrashed.
+ * Freed blocks are kept by the arena, by default up to the most bytes ever in use at once (the arrays of the largest structure),
+ * so a rebuilt structure gets the smallest kept block big enough for each array, without new page faults.
+ * Over the limit the smallest kept blocks are unmapped first, the big ones save the most page faults.
+ * Smaller blocks go to the default operator new.
+ */
+
+class PageArena
+{
+public:
+
+	static constexpr std::size_t hugePageSize{ std::size_t{ 1 } << 21 };
+
+	static PageArena& instance(void);
+
+	void* allocate(const std::size_t bytes);
+
+	void deallocate(void* pointer, const std::size_t bytes) noexcept;
+
+	/* Unmaps the kept blocks. */
+	void release(void) noexcept;
+
+	static constexpr std::size_t automaticKept{ std::numeric_limits<std::size_t>::max() };
+
+	/*
+	 * Most bytes of freed blocks kept for reuse, 0 unmaps every block when it's freed.
+	 * automaticKept (the default) follows the most bytes ever in use at once.
+	 */
+	void setMaximumKept(const std::size_t bytes) noexcept;
+
+	/* Bytes mapped so far, a rebuild that reuses the kept blocks doesn't raise it. */
+	std::size_t mappedBytes(void) noexcept;
+
+	~PageArena();
+
+private:
+
+	PageArena() = default;
+
+	static void* map(const std::size_t bytes);
+
+	static void unmap(void* pointer, const std::size_t bytes) noexcept;
+
+	/* Unmaps the smallest kept blocks until the limit is kept at most. The mutex must be locked. */
+	void trim(void) noexcept;
+
+	std::mutex mutex_;
+
+	std::size_t maximumKept_{ automaticKept };
+	std::size_t keptBytes_{ 0 };
+	std::size_t usedBytes_{ 0 };
+	std::size_t peakUsedBytes_{ 0 };
+	std::size_t mappedBytes_{ 0 };
+
+	/* Kept blocks, by their (rounded) size. */
+	std::multimap<std::size_t, void*> freeBlocks_;
+
+	/* Size of the mapped blocks in use, which can be bigger than asked when a kept block was reused. */
+	std::unordered_map<void*, std::size_t> usedBlocks_;
+};
+
+/*
+ * Allocator of the arena. Resizing a vector doesn't initialize trivially copyable elements,
+ * they are set afterwards with parallelFill or parallelIota, or overwritten anyway.
+ */
+template<class T>
+struct HugePageAllocator
+{
+	using value_type = T;
+
+	HugePageAllocator() = default;
+
+	template<class U>
+	HugePageAllocator(const HugePageAllocator<U>&) noexcept
+	{}
+
+	T* allocate(const std::size_t n)
+	{
+		return static_cast<T*>(PageArena::instance().allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, const std::size_t n) noexcept
+	{
+		PageArena::instance().deallocate(pointer, n * sizeof(T));
+	}
+
+	template<class U>
+	void construct(U* pointer) noexcept(std::is_nothrow_default_constructible_v<U>)
+	{
+		if constexpr (!std::is_trivially_copyable_v<U> || !std::is_trivially_destructible_v<U>)
+			::new(static_cast<void*>(pointer)) U();
+	}
+
+	template<class U, class... Args>
+	void construct(U* pointer, Args&&... args)
+	{
+		::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	friend bool operator==(const HugePageAllocator&, const HugePageAllocator<U>&) noexcept
+	{
+		return true;
+	}
+};
+
+template<class T>
+using HugeVector = std::vector<T, HugePageAllocator<T>>;
+
+namespace ParallelMemory
+{
+	/* Splits [from, to) among the threads, so each page is first touched by one of them. */
+	template<class Function>
+	void forRanges(const std::size_t from, const std::size_t to, Function&& function)
+	{
+		constexpr std::size_t minimumRange{ std::size_t{ 1 } << 16 };
+
+		const std::size_t threads{ std::clamp<std::size_t>((to - from) / minimumRange, 1, std::max(std::jthread::hardware_concurrency() / 2, 1U)) };
+
+		if (threads == 1)
+		{
+			function(from, to);
+			return;
+		}
+
+		const auto rangeSize{ (to - from) / threads };
+
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(threads);
+
+		for (std::size_t index{ threads }; index--;)
+			threadPool.emplace_back(function, from + index * rangeSize, index + 1 == threads ? to : from + (index + 1) * rangeSize);
+	}
+}
+
+/* Sets the elements from index from on to value. */
+template<class T, class Allocator>
+void parallelFill(std::vector<T, Allocator>& data, const T& value, const std::size_t from = 0)
+{
+	ParallelMemory::forRanges(from, data.size(), [&data, &value](const std::size_t first, const std::size_t last)
+	{
+		std::fill(data.begin() + first, data.begin() + last, value);
+	});
+}
+
+/* Sets every element to its own index. */
+template<class T, class Allocator>
+void parallelIota(std::vector<T, Allocator>& data)
+{
+	ParallelMemory::forRanges(0, data.size(), [&data](const std::size_t first, const std::size_t last)
+	{
+		for (auto index{ first }; index < last; ++index)
+			data[index] = static_cast<T>(index);
+	});
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RADIUS_2D_HAS_SSE2
+#endif
+
+/*
+ * Metric policies of SpatialStruct, resolved at compile time.
+ *
+ * cellFactor: chunk side is scale * cellFactor, so any two points of a chunk are within scale.
+ * threshold:  the value within() compares to, computed once from scale.
+ * within:     the distance test on the coordinate differences (no sqrt, no branches).
+ * reaches:    whether two chunks with the given gap (in scale units) may hold points within scale.
+ *
+ * With SSE2, within is overloaded on packed doubles too, giving a lane mask (see anyWithin).
+ */
+
+#ifdef RADIUS_2D_HAS_SSE2
+namespace PackedMetric
+{
+	inline __m128d abs(const __m128d value) noexcept
+	{
+		return _mm_andnot_pd(_mm_set1_pd(-0.0), value);
+	}
+}
+#endif
+
+struct Euclidean
+{
+	static constexpr std::uint32_t id{ 0 };
+	static constexpr double cellFactor{ 0.70710678118654752440 };
+
+	static constexpr double threshold(const double scale) noexcept
+	{
+		return scale * scale;
+	}
+
+	static constexpr bool within(const double xd, const double yd, const double threshold) noexcept
+	{
+		return xd * xd + yd * yd <= threshold;
+	}
+
+#ifdef RADIUS_2D_HAS_SSE2
+	static __m128d within(const __m128d xd, const __m128d yd, const __m128d threshold) noexcept
+	{
+		return _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(xd, xd), _mm_mul_pd(yd, yd)), threshold);
+	}
+#endif
+
+	static constexpr bool reaches(const double xGap, const double yGap) noexcept
+	{
+		return xGap * xGap + yGap * yGap < 1.0 - 1.0e-9;
+	}
+};
+
+/* L∞: chunks are scale wide, 8 neighbours, and the test needs no multiply. */
+struct Chebyshev
+{
+	static constexpr std::uint32_t id{ 1 };
+	static constexpr double cellFactor{ 1.0 };
+
+	static constexpr double threshold(const double scale) noexcept
+	{
+		return scale;
+	}
+
+	static constexpr bool within(const double xd, const double yd, const double threshold) noexcept
+	{
+		return (xd <= threshold) & (-xd <= threshold) & (yd <= threshold) & (-yd <= threshold);
+	}
+
+#ifdef RADIUS_2D_HAS_SSE2
+	static __m128d within(const __m128d xd, const __m128d yd, const __m128d threshold) noexcept
+	{
+		return _mm_and_pd(_mm_cmple_pd(PackedMetric::abs(xd), threshold), _mm_cmple_pd(PackedMetric::abs(yd), threshold));
+	}
+#endif
+
+	static constexpr bool reaches(const double xGap, const double yGap) noexcept
+	{
+		return std::max(xGap, yGap) < 1.0 - 1.0e-9;
+	}
+};
+
+/* L1: the chunk diameter is twice its side, so chunks are scale / 2 wide. */
+struct Manhattan
+{
+	static constexpr std::uint32_t id{ 2 };
+	static constexpr double cellFactor{ 0.5 };
+
+	static constexpr double threshold(const double scale) noexcept
+	{
+		return scale;
+	}
+
+	static constexpr bool within(const double xd, const double yd, const double threshold) noexcept
+	{
+		return (xd < 0.0 ? -xd : xd) + (yd < 0.0 ? -yd : yd) <= threshold;
+	}
+
+#ifdef RADIUS_2D_HAS_SSE2
+	static __m128d within(const __m128d xd, const __m128d yd, const __m128d threshold) noexcept
+	{
+		return _mm_cmple_pd(_mm_add_pd(PackedMetric::abs(xd), PackedMetric::abs(yd)), threshold);
+	}
+#endif
+
+	static constexpr bool reaches(const double xGap, const double yGap) noexcept
+	{
+		return xGap + yGap < 1.0 - 1.0e-9;
+	}
+};
+
+/*
+ * Whether any of the size points of (xs, ys) is within threshold of (x, y), the kernel of the chunk comparisons.
+ * With SSE2, two points are tested per compare and the masks are ORed, so the loop has no branch
+ * and a single movemask at the end (a bool OR of scalar compares isn't vectorized by the compilers).
+ */
+template<class Metric>
+bool anyWithin(const double* xs, const double* ys, const std::size_t size, const double x, const double y, const double threshold) noexcept
+{
+	std::size_t index{ 0 };
+	bool found{ false };
+
+#ifdef RADIUS_2D_HAS_SSE2
+	const auto packedX{ _mm_set1_pd(x) };
+	const auto packedY{ _mm_set1_pd(y) };
+	const auto packedThreshold{ _mm_set1_pd(threshold) };
+
+	auto mask{ _mm_setzero_pd() };
+
+	for (; index + 2 <= size; index += 2)
+		mask = _mm_or_pd(mask, Metric::within(_mm_sub_pd(_mm_loadu_pd(xs + index), packedX), _mm_sub_pd(_mm_loadu_pd(ys + index), packedY), packedThreshold));
+
+	found = _mm_movemask_pd(mask) != 0;
+#endif
+
+	for (; index < size; ++index)
+		found |= Metric::within(xs[index] - x, ys[index] - y, threshold);
+
+	return found;
+}
+
+/*
+ * Neighbour chunks of a chunk, as (row, column) offsets.
+ * The forward half (later rows, or later columns of the same row) is enough for the serial traversal,
+ * the parallel one visits all of them.
+ */
+template<class Metric>
+struct Stencil
+{
+	struct Offset
+	{
+		int row;
+		int column;
+	};
+
+	static constexpr int reach{ static_cast<int>(1.0 / Metric::cellFactor) + 1 };
+
+	static constexpr bool contains(const int row, const int column, const bool forward) noexcept
+	{
+		if (row == 0 && column == 0)
+			return false;
+
+		if (forward && (row < 0 || (row == 0 && column < 0)))
+			return false;
+
+		const auto gap = [](const int offset) { return std::max((offset < 0 ? -offset : offset) - 1, 0) * Metric::cellFactor; };
+
+		return Metric::reaches(gap(column), gap(row));
+	}
+
+	static constexpr std::size_t count(const bool forward) noexcept
+	{
+		std::size_t result{ 0 };
+
+		for (int row{ -reach }; row <= reach; ++row)
+			for (int column{ -reach }; column <= reach; ++column)
+				result += contains(row, column, forward);
+
+		return result;
+	}
+
+	template<bool forward>
+	static constexpr auto offsets = []
+	{
+		std::array<Offset, count(forward)> result{};
+		std::size_t index{ 0 };
+
+		for (int row{ -reach }; row <= reach; ++row)
+			for (int column{ -reach }; column <= reach; ++column)
+				if (contains(row, column, forward))
+					result[index++] = { row, column };
+
+		return result;
+	}();
+
+	/* How many rows after a chunk the forward stencil looks at. */
+	static constexpr int rows = []
+	{
+		int result{ 0 };
+
+		for (const auto& offset : offsets<true>)
+			result = std::max(result, offset.row);
+
+		return result;
+	}();
+};
+
+static_assert(Stencil<Euclidean>::count(false) == 20 && Stencil<Euclidean>::count(true) == 10);
+static_assert(Stencil<Chebyshev>::count(false) == 8 && Stencil<Chebyshev>::count(true) == 4);
+static_assert(Stencil<Manhattan>::count(false) == 20 && Stencil<Manhattan>::count(true) == 10);
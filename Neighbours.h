@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "Point.h"
+#include "Metric.h"
+
+/*
+ * Radius query around a point, shared by the cross match of SpatialStruct and by SpatialSnapshot,
+ * so both search the same chunks with the same rounding.
+ */
+
+struct NeighbourGrid
+{
+	double minX{ 0.0 };
+	double minY{ 0.0 };
+	double chunkLength{ 0.0 };
+	std::uint64_t rows{ 0 };
+	std::uint64_t columns{ 0 };
+};
+
+namespace Neighbours
+{
+	/*
+	 * Calls visitor(index) for the points within scale of point, until it returns false (then returns false too).
+	 *
+	 * With a grid, the chunk of point (clamped at the last row and column, like the insertion) and its stencil are searched,
+	 * chunkPoints(row, column, visitPoint) walks the points of a chunk inside the grid, and stops when visitPoint returns false.
+	 * Without a grid, order holds the point indices sorted by x, and only a window of 2 * scale is searched.
+	 * pointAt(index) gives the point of an index.
+	 */
+	template<class Metric, class Order, class PointAt, class ChunkPoints, class Visitor>
+	bool visit(const Point& point, const double scale, const NeighbourGrid* grid, const Order& order,
+			   PointAt&& pointAt, ChunkPoints&& chunkPoints, Visitor&& visitor)
+	{
+		const auto threshold{ Metric::threshold(scale) };
+
+		auto visitPoint = [&](const auto index)
+		{
+			const Point& other{ pointAt(index) };
+			return !Metric::within(other.x() - point.x(), other.y() - point.y(), threshold) || visitor(index);
+		};
+
+		if (!grid)
+		{
+			auto position{ std::lower_bound(std::begin(order), std::end(order), point.x() - scale,
+								[&pointAt](const auto index, const double x) { return pointAt(index).x() < x; }) };
+
+			for (; position != std::end(order) && pointAt(*position).x() <= point.x() + scale; ++position)
+				if (!visitPoint(*position))
+					return false;
+
+			return true;
+		}
+
+		const auto rows{ static_cast<double>(grid->rows) };
+		const auto columns{ static_cast<double>(grid->columns) };
+
+		const auto rowValue{ std::floor((point.y() - grid->minY) / grid->chunkLength) };
+		const auto columnValue{ std::floor((point.x() - grid->minX) / grid->chunkLength) };
+
+		if (!(rowValue >= -Stencil<Metric>::reach && rowValue <= rows + Stencil<Metric>::reach &&
+			  columnValue >= -Stencil<Metric>::reach && columnValue <= columns + Stencil<Metric>::reach))
+			return true;
+
+		const auto row{ static_cast<std::int64_t>(rowValue) - (rowValue == rows) };
+		const auto column{ static_cast<std::int64_t>(columnValue) - (columnValue == columns) };
+
+		auto visitChunk = [&](const std::int64_t chunkRow, const std::int64_t chunkColumn)
+		{
+			if (chunkRow < 0 || chunkColumn < 0 || std::cmp_greater_equal(chunkRow, grid->rows) || std::cmp_greater_equal(chunkColumn, grid->columns))
+				return true;
+
+			return chunkPoints(static_cast<std::uint64_t>(chunkRow), static_cast<std::uint64_t>(chunkColumn), visitPoint);
+		};
+
+		if (!visitChunk(row, column))
+			return false;
+
+		for (const auto& [rowOffset, columnOffset] : Stencil<Metric>::template offsets<false>)
+			if (!visitChunk(row + rowOffset, column + columnOffset))
+				return false;
+
+		return true;
+	}
+}
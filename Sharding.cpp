@@ -0,0 +1,630 @@
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <format>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Sharding.h"
+
+static const auto availableThreads = std::max(std::jthread::hardware_concurrency() / 2, 1U);
+
+static_assert(std::is_trivially_copyable_v<Point>, "Points are sent to the workers as raw bytes.");
+
+namespace
+{
+	/* Wire format, fixed width so a worker can run on another host of the same architecture. */
+
+	struct ShardRequest
+	{
+		double scale;
+		double minX;
+		double maxX;
+		double minY;
+		double maxY;
+		std::uint64_t points;
+		std::uint64_t corePoints;
+		std::uint64_t boundaryPoints;
+		std::uint32_t stableCC;
+		std::uint32_t withLabels;
+	};
+
+	struct ShardReply
+	{
+		std::uint64_t coreClusters;
+		std::uint64_t records;
+		std::uint32_t status;
+		std::uint32_t withLabels;
+	};
+
+	/* Label of a boundary point, point is the index inside the tile, so a tile holds less than maxTilePoints points. */
+	struct ShardRecord
+	{
+		std::uint32_t point;
+		std::uint32_t label;
+		std::uint32_t labelHasCore;
+	};
+
+	constexpr std::uint64_t maxTilePoints{ std::numeric_limits<std::uint32_t>::max() };
+
+	constexpr std::uint32_t statusOk{ 0 };
+	constexpr std::uint32_t statusFailed{ 1 };
+
+	class SocketChannel final : public ShardChannel
+	{
+	public:
+
+		SocketChannel(const int socket, const pid_t child) :
+			socket_{ socket }, child_{ child } {}
+
+		~SocketChannel() override
+		{
+			join();
+		}
+
+		bool send(const void* data, const std::size_t bytes) override
+		{
+			auto* current{ static_cast<const char*>(data) };
+
+			for (auto remaining{ bytes }; remaining;)
+			{
+				const auto sent{ ::send(socket_, current, remaining, MSG_NOSIGNAL) };
+
+				if (sent < 0 && errno == EINTR)
+					continue;
+
+				if (sent <= 0)
+					return false;
+
+				current += sent;
+				remaining -= static_cast<std::size_t>(sent);
+			}
+
+			return true;
+		}
+
+		bool receive(void* data, const std::size_t bytes) override
+		{
+			auto* current{ static_cast<char*>(data) };
+
+			for (auto remaining{ bytes }; remaining;)
+			{
+				const auto received{ ::recv(socket_, current, remaining, 0) };
+
+				if (received < 0 && errno == EINTR)
+					continue;
+
+				if (received <= 0)
+					return false;
+
+				current += received;
+				remaining -= static_cast<std::size_t>(received);
+			}
+
+			return true;
+		}
+
+		bool join(void) override
+		{
+			if (socket_ >= 0)
+			{
+				::close(socket_);
+				socket_ = -1;
+			}
+
+			if (child_ <= 0)
+				return succeeded_;
+
+			int status{ 0 };
+
+			while (::waitpid(child_, &status, 0) < 0 && errno == EINTR);
+
+			child_ = 0;
+			succeeded_ = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+			return succeeded_;
+		}
+
+	private:
+
+		int socket_{ -1 };
+		pid_t child_{ 0 };
+		bool succeeded_{ true };
+	};
+
+	/* Union find over the (tile, label) keys of the boundary labels only. */
+	class BoundaryUnion
+	{
+	public:
+
+		std::uint64_t find(const std::uint64_t key)
+		{
+			auto root{ key };
+
+			for (auto it{ parents_.find(root) }; it != parents_.end() && it->second != root; it = parents_.find(root))
+				root = it->second;
+
+			for (auto current{ key }; current != root;)
+			{
+				auto& parent{ parents_[current] };
+				current = std::exchange(parent, root);
+			}
+
+			return root;
+		}
+
+		bool unite(const std::uint64_t a, const std::uint64_t b)
+		{
+			const auto rootA{ find(a) };
+			const auto rootB{ find(b) };
+
+			if (rootA == rootB)
+				return false;
+
+			parents_[rootB] = rootA;
+
+			return true;
+		}
+
+	private:
+
+		std::unordered_map<std::uint64_t, std::uint64_t> parents_;
+	};
+
+	constexpr std::uint64_t labelKey(const Integer tile, const std::uint32_t label) noexcept
+	{
+		return static_cast<std::uint64_t>(tile) << 32 | label;
+	}
+
+	/* Number of threads of the process, 0 where it can't be read. */
+	std::uint64_t runningThreads(void)
+	{
+		std::ifstream status("/proc/self/status");
+
+		for (std::string line; std::getline(status, line);)
+			if (line.starts_with("Threads:"))
+				return std::stoull(line.substr(8));
+
+		return 0;
+	}
+}
+
+std::unique_ptr<ShardChannel> ForkSocketTransport::spawn(const Worker& worker)
+{
+	if (runningThreads() > 1)
+	{
+		std::cout << "\nThe process runs other threads (parallel algorithms backend or a thread pool), so it can't fork. Shard worker wasn't started...\n";
+		return nullptr;
+	}
+
+	int sockets[2];
+
+	if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+		return nullptr;
+
+	const auto child{ ::fork() };
+
+	if (child < 0)
+	{
+		::close(sockets[0]);
+		::close(sockets[1]);
+		return nullptr;
+	}
+
+	if (child == 0)
+	{
+		::close(sockets[0]);
+
+		bool succeeded{ false };
+		{
+			SocketChannel channel(sockets[1], 0);
+			succeeded = worker(channel);
+		}
+
+		::_exit(succeeded ? 0 : 1);
+	}
+
+	::close(sockets[1]);
+
+	return std::make_unique<SocketChannel>(sockets[0], child);
+}
+
+bool runShardWorker(ShardChannel& channel)
+{
+	ShardRequest request{};
+
+	if (!channel.receive(&request, sizeof(request)))
+		return false;
+
+	ShardReply reply{ 0, 0, statusFailed, request.withLabels };
+
+	if (request.points >= maxTilePoints)
+	{
+		channel.send(&reply, sizeof(reply));
+		return false;
+	}
+
+	std::vector<Point> points(request.points);
+
+	if (!channel.receive(points.data(), points.size() * sizeof(Point)))
+		return false;
+
+	SpatialStruct<> spatial(points, request.scale, false);
+	spatial.computeClusters(request.stableCC);
+
+	const auto labels{ spatial.getLabels() };
+
+	if (labels.size() != points.size())
+	{
+		channel.send(&reply, sizeof(reply));
+		return false;
+	}
+
+	const auto corePoints{ static_cast<std::size_t>(request.corePoints) };
+
+	std::vector<char> labelHasCore(points.size(), 0);
+
+	for (std::size_t index{ 0 }; index < corePoints; ++index)
+		labelHasCore[labels[index]] = 1;
+
+	reply.coreClusters = std::count(labelHasCore.cbegin(), labelHasCore.cend(), 1);
+
+	/* Only the boundary core points and the halo points leave the worker. */
+	std::vector<ShardRecord> records;
+	records.reserve(request.boundaryPoints + points.size() - corePoints);
+
+	auto addRecords = [&](const std::size_t fromIndex, const std::size_t toIndex)
+	{
+		for (auto index{ fromIndex }; index < toIndex; ++index)
+		{
+			const auto label{ labels[index] };
+			records.push_back({ static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(label), static_cast<std::uint32_t>(labelHasCore[label]) });
+		}
+	};
+
+	addRecords(0, request.boundaryPoints);
+	addRecords(corePoints, points.size());
+
+	reply.records = records.size();
+	reply.status = statusOk;
+
+	if (!channel.send(&reply, sizeof(reply)) || !channel.send(records.data(), records.size() * sizeof(ShardRecord)))
+		return false;
+
+	if (!request.withLabels)
+		return true;
+
+	std::vector<std::uint32_t> coreLabels(labels.cbegin(), labels.cbegin() + corePoints);
+
+	return channel.send(coreLabels.data(), coreLabels.size() * sizeof(std::uint32_t));
+}
+
+ShardedClustering::ShardedClustering(std::vector<Point>& data, const double scale, ShardTransport& transport,
+									const Integer tilesX, const Integer tilesY, const Integer maxWorkers, const bool verbose) :
+	printMessages_{ verbose }, scale_{ scale }, tilesX_{ std::max<Integer>(tilesX, 1) }, tilesY_{ std::max<Integer>(tilesY, 1) },
+	maxWorkers_{ std::max<Integer>(maxWorkers, 1) }, Points_{ data }, transport_{ transport }
+{
+	if (!data.size() || data.size() >= maxValue || scale <= 0.0L || !std::isfinite(scale * scale))
+	{
+		std::cout << "\nScale lenght is not positive or is too big, or point set is empty or too big. Structure wasn't created...\n";
+		return;
+	}
+
+	computeBounds();
+
+	if (!std::isfinite(std::pow(maxX_ - minX_, 2) + std::pow(maxY_ - minY_, 2)))
+	{
+		std::cout << "\nNumber range is too big. Result may be incorrect. Structure wasn't created...\n";
+		return;
+	}
+
+	partition();
+
+	if (std::any_of(tilePoints_.cbegin(), tilePoints_.cend(), [](const auto& points) { return points.size() >= maxTilePoints; }))
+	{
+		std::cout << "\nA tile has too many points for the labels sent by the workers, use more tiles. Structure wasn't created...\n";
+		return;
+	}
+
+	initialized_ = true;
+}
+
+void ShardedClustering::printMessage(const std::string_view message) const
+{
+	if (printMessages_)
+		std::cout << "\n" << message << "\n";
+}
+
+/* Same bounds as SpatialStruct::initialize, but with plain threads, so the process stays safe to fork. */
+void ShardedClustering::computeBounds(void)
+{
+	const auto N{ static_cast<Integer>(Points_.size()) };
+	const auto pointsPerThread{ N / availableThreads + 1 };
+
+	std::vector<std::array<double, 4>> threadBounds(availableThreads, { maxPointValue, minPointValue, maxPointValue, minPointValue });
+
+	auto boundsLambda = [&](const Integer thread)
+	{
+		auto& [minX, maxX, minY, maxY] = threadBounds[thread];
+
+		for (Integer index{ thread * pointsPerThread }; index < std::min(N, (thread + 1) * pointsPerThread); ++index)
+		{
+			const auto& point{ Points_[index] };
+
+			minX = std::min(minX, point.x());
+			maxX = std::max(maxX, point.x());
+			minY = std::min(minY, point.y());
+			maxY = std::max(maxY, point.y());
+		}
+	};
+
+	{
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(availableThreads);
+
+		for (Integer index{ availableThreads }; index--;)
+			threadPool.emplace_back(boundsLambda, index);
+	}
+
+	for (const auto& [minX, maxX, minY, maxY] : threadBounds)
+	{
+		minX_ = std::min(minX_, minX);
+		maxX_ = std::max(maxX_, maxX);
+		minY_ = std::min(minY_, minY);
+		maxY_ = std::max(maxY_, maxY);
+	}
+}
+
+Integer ShardedClustering::tileOf(const double value, const double minValue, const double tileLength, const Integer tiles) const noexcept
+{
+	if (value <= minValue)
+		return 0;
+
+	return std::min(static_cast<Integer>((value - minValue) / tileLength), tiles - 1);
+}
+
+void ShardedClustering::partition(void)
+{
+	if (maxX_ == minX_)
+		tilesX_ = 1;
+
+	if (maxY_ == minY_)
+		tilesY_ = 1;
+
+	tileWidth_ = maxX_ > minX_ ? (maxX_ - minX_) / tilesX_ : scale_;
+	tileHeight_ = maxY_ > minY_ ? (maxY_ - minY_) / tilesY_ : scale_;
+
+	const auto numberOfTiles{ tilesX_ * tilesY_ };
+
+	tilePoints_.assign(numberOfTiles, {});
+	tileCorePoints_.assign(numberOfTiles, 0);
+
+	std::vector<Integer> boundaryPoints(numberOfTiles, 0);
+	std::vector<Integer> haloPoints(numberOfTiles, 0);
+
+	/*
+	 * Visits the core tile and the halo tiles of every point,
+	 * a halo tile is any other tile within scale of the point in both axis.
+	 */
+	auto visitTiles = [this](const Point& point, auto&& onCore, auto&& onHalo)
+	{
+		const auto coreX{ tileOf(point.x(), minX_, tileWidth_, tilesX_) };
+		const auto coreY{ tileOf(point.y(), minY_, tileHeight_, tilesY_) };
+		const auto core{ coreY * tilesX_ + coreX };
+
+		bool boundary{ false };
+
+		for (auto y{ tileOf(point.y() - scale_, minY_, tileHeight_, tilesY_) }; y <= tileOf(point.y() + scale_, minY_, tileHeight_, tilesY_); ++y)
+			for (auto x{ tileOf(point.x() - scale_, minX_, tileWidth_, tilesX_) }; x <= tileOf(point.x() + scale_, minX_, tileWidth_, tilesX_); ++x)
+				if (const auto tile{ y * tilesX_ + x }; tile != core)
+				{
+					onHalo(tile);
+					boundary = true;
+				}
+
+		onCore(core, boundary);
+	};
+
+	for (const auto& point : Points_)
+		visitTiles(point,
+			[&](const Integer tile, const bool boundary) { ++tileCorePoints_[tile]; boundaryPoints[tile] += boundary; },
+			[&](const Integer tile) { ++haloPoints[tile]; });
+
+	/* Each tile is laid out as: boundary core points, interior core points, halo points. */
+	std::vector<Integer> nextBoundary(numberOfTiles, 0);
+	std::vector<Integer> nextInterior(boundaryPoints);
+	std::vector<Integer> nextHalo(tileCorePoints_);
+
+	for (Integer tile{ numberOfTiles }; tile--;)
+		tilePoints_[tile].resize(tileCorePoints_[tile] + haloPoints[tile]);
+
+	for (Integer index{ 0 }; index < Points_.size(); ++index)
+		visitTiles(Points_[index],
+			[&](const Integer tile, const bool boundary) { tilePoints_[tile][boundary ? nextBoundary[tile]++ : nextInterior[tile]++] = index; },
+			[&](const Integer tile) { tilePoints_[tile][nextHalo[tile]++] = index; });
+
+	tileBoundaryPoints_ = std::move(boundaryPoints);
+
+	printMessage(std::format("Tiles: {} x {}, tile size: {} x {}", tilesX_, tilesY_, tileWidth_, tileHeight_));
+}
+
+Integer ShardedClustering::computeClusters(const bool stableCC, const bool withLabels)
+{
+	if (!initialized_)
+		return 0;
+
+	if (clusters_ && (!withLabels || !labels_.empty()))
+		return clusters_;
+
+	const auto numberOfTiles{ tilesX_ * tilesY_ };
+
+	std::uint64_t coreClusters{ 0 };
+	std::unordered_map<Integer, std::uint64_t> ownerLabels;
+	std::vector<std::pair<Integer, std::uint64_t>> haloLabels;
+	std::unordered_set<std::uint64_t> haloOnlyLabels;
+	std::vector<std::uint64_t> pointLabels(withLabels ? Points_.size() : 0);
+
+	auto receiveTile = [&](const Integer tile, ShardChannel& channel)
+	{
+		ShardReply reply{};
+
+		if (!channel.receive(&reply, sizeof(reply)) || reply.status != statusOk)
+			return false;
+
+		std::vector<ShardRecord> records(reply.records);
+
+		if (!channel.receive(records.data(), records.size() * sizeof(ShardRecord)))
+			return false;
+
+		const auto& points{ tilePoints_[tile] };
+
+		coreClusters += reply.coreClusters;
+
+		for (const auto& [point, label, labelHasCore] : records)
+		{
+			const auto key{ labelKey(tile, label) };
+
+			if (point < tileCorePoints_[tile])
+				ownerLabels.emplace(points[point], key);
+			else
+				haloLabels.emplace_back(points[point], key);
+
+			if (!labelHasCore)
+				haloOnlyLabels.insert(key);
+		}
+
+		if (!withLabels)
+			return true;
+
+		std::vector<std::uint32_t> coreLabels(tileCorePoints_[tile]);
+
+		if (!channel.receive(coreLabels.data(), coreLabels.size() * sizeof(std::uint32_t)))
+			return false;
+
+		for (Integer index{ static_cast<Integer>(coreLabels.size()) }; index--;)
+			pointLabels[points[index]] = labelKey(tile, coreLabels[index]);
+
+		return true;
+	};
+
+	std::vector<Integer> tiles;
+
+	for (Integer tile{ 0 }; tile < numberOfTiles; ++tile)
+		if (tileCorePoints_[tile])
+			tiles.push_back(tile);
+
+	printMessage(std::format("Running {} shards with up to {} workers...", tiles.size(), maxWorkers_));
+
+	bool succeeded{ true };
+	std::vector<Point> buffer;
+
+	for (std::size_t first{ 0 }; first < tiles.size() && succeeded; first += maxWorkers_)
+	{
+		const auto last{ std::min(tiles.size(), first + maxWorkers_) };
+
+		std::vector<std::unique_ptr<ShardChannel>> channels;
+
+		for (auto position{ first }; position < last; ++position)
+		{
+			const auto tile{ tiles[position] };
+			const auto& points{ tilePoints_[tile] };
+
+			const auto tileX{ tile % tilesX_ };
+			const auto tileY{ tile / tilesX_ };
+
+			const ShardRequest request{ scale_, minX_ + tileX * tileWidth_, minX_ + (tileX + 1) * tileWidth_,
+										minY_ + tileY * tileHeight_, minY_ + (tileY + 1) * tileHeight_,
+										points.size(), tileCorePoints_[tile], tileBoundaryPoints_[tile], stableCC, withLabels };
+
+			buffer.resize(points.size());
+
+			for (Integer index{ static_cast<Integer>(points.size()) }; index--;)
+				buffer[index] = Points_[points[index]];
+
+			auto channel{ transport_.spawn(runShardWorker) };
+
+			if (!channel || !channel->send(&request, sizeof(request)) || !channel->send(buffer.data(), buffer.size() * sizeof(Point)))
+			{
+				succeeded = false;
+				break;
+			}
+
+			channels.push_back(std::move(channel));
+		}
+
+		for (std::size_t index{ 0 }; index < channels.size(); ++index)
+			succeeded = receiveTile(tiles[first + index], *channels[index]) && channels[index]->join() && succeeded;
+	}
+
+	if (!succeeded)
+	{
+		std::cout << "\nA shard worker failed. Clusters weren't computed...\n";
+		return 0;
+	}
+
+	BoundaryUnion boundaryUnion;
+	std::uint64_t unions{ 0 };
+
+	for (const auto& [point, key] : haloLabels)
+	{
+		const auto owner{ ownerLabels.find(point) };
+
+		if (owner == ownerLabels.end()) [[unlikely]]
+		{
+			std::cout << "\nA halo point has no owner label. Clusters weren't computed...\n";
+			return 0;
+		}
+
+		unions += boundaryUnion.unite(owner->second, key);
+	}
+
+	clusters_ = static_cast<Integer>(coreClusters + haloOnlyLabels.size() - unions);
+
+	if (withLabels)
+	{
+		std::unordered_map<std::uint64_t, Integer> clusterIds;
+		labels_.resize(Points_.size());
+
+		for (Integer index{ static_cast<Integer>(Points_.size()) }; index--;)
+		{
+			const auto root{ boundaryUnion.find(pointLabels[index]) };
+			labels_[index] = clusterIds.try_emplace(root, static_cast<Integer>(clusterIds.size())).first->second;
+		}
+	}
+
+	printMessage(std::format("Boundary labels: {}, unions: {}", ownerLabels.size() + haloLabels.size(), unions));
+
+	return clusters_;
+}
+
+const std::vector<Integer>& ShardedClustering::getLabels(void) const noexcept
+{
+	return labels_;
+}
+
+std::set<std::set<Integer>> ShardedClustering::getClusters(void) const
+{
+	if (!initialized_ || labels_.empty())
+		return {};
+
+	std::unordered_map<Integer, std::set<Integer>> clustersMap;
+
+	for (Integer index{ static_cast<Integer>(labels_.size()) }; index--;)
+		clustersMap[labels_[index]].insert(index);
+
+	std::set<std::set<Integer>> clustersSet;
+
+	for (auto& [first, second] : clustersMap)
+		clustersSet.insert(std::move(second));
+
+	return clustersSet;
+}
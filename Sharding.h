@@ -0,0 +1,118 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+#include "SpatialStruct.h"
+
+/*
+ * Sharded mode: the coordinator cuts the bounding box into tilesX * tilesY tiles,
+ * and sends to each worker the points of its tile (core) plus the points lying
+ * up to scale outside of it (halo).
+ * Every edge of the radius graph that touches a core point is then seen by the worker owning it,
+ * so the workers only have to return the labels of the points near their tile border,
+ * and the coordinator unites the labels that share a point.
+ * A label with core points is a local cluster, a label with only halo points is always
+ * united with the cluster of its owner tile, so: clusters = coreClusters + haloOnlyLabels - unions.
+ */
+
+class ShardChannel
+{
+public:
+
+	virtual ~ShardChannel() = default;
+
+	virtual bool send(const void* data, const std::size_t bytes) = 0;
+
+	virtual bool receive(void* data, const std::size_t bytes) = 0;
+
+	/* Waits for the worker to finish, returns false if it failed. */
+	virtual bool join(void) = 0;
+};
+
+class ShardTransport
+{
+public:
+
+	using Worker = std::function<bool(ShardChannel&)>;
+
+	virtual ~ShardTransport() = default;
+
+	virtual std::unique_ptr<ShardChannel> spawn(const Worker& worker) = 0;
+};
+
+/*
+ * Runs every worker in a forked child process, connected to the coordinator with a Unix socket pair.
+ * Fork only copies the calling thread, so forking after the parallel algorithms backend (TBB) or any thread pool
+ * has started is unsupported: spawn refuses it when the process runs other threads (read from /proc on Linux),
+ * and then the clusters aren't computed. The coordinator itself only uses std::jthread, joined before every fork.
+ */
+class ForkSocketTransport final : public ShardTransport
+{
+public:
+
+	std::unique_ptr<ShardChannel> spawn(const Worker& worker) override;
+};
+
+/* Worker side of the protocol, for transports that host the workers themselves. */
+bool runShardWorker(ShardChannel& channel);
+
+class ShardedClustering
+{
+public:
+
+	/* The workers send 32 bit indices and labels, so a tile (core and halo) with 2^32 - 1 points or more isn't created. */
+	ShardedClustering(std::vector<Point>& data, const double scale, ShardTransport& transport,
+					const Integer tilesX, const Integer tilesY, const Integer maxWorkers, const bool verbose = true);
+
+	ShardedClustering(const std::vector<Point>&& data, const double scale, ShardTransport& transport,
+					const Integer tilesX, const Integer tilesY, const Integer maxWorkers) = delete;
+
+	Integer computeClusters(const bool stableCC = true, const bool withLabels = false);
+
+	/* Global label of every point, available if the clusters were computed with labels. */
+	const std::vector<Integer>& getLabels(void) const noexcept;
+
+	std::set<std::set<Integer>> getClusters(void) const;
+
+private:
+
+/* Methods */
+
+	void printMessage(const std::string_view message) const;
+
+	void computeBounds(void);
+
+	void partition(void);
+
+	Integer tileOf(const double value, const double minValue, const double tileLength, const Integer tiles) const noexcept;
+
+/* Fields */
+
+	bool printMessages_{ true };
+	bool initialized_{ false };
+
+	double minX_{ maxPointValue };
+	double maxX_{ minPointValue };
+	double minY_{ maxPointValue };
+	double maxY_{ minPointValue };
+	double scale_{ 0.0 };
+	double tileWidth_{ 0.0 };
+	double tileHeight_{ 0.0 };
+
+	Integer tilesX_{ 1 };
+	Integer tilesY_{ 1 };
+	Integer maxWorkers_{ 1 };
+	Integer clusters_{ 0 };
+
+	std::vector<Point>& Points_;
+	ShardTransport& transport_;
+
+	/* Global indices of every tile, core points first. */
+	std::vector<std::vector<Integer>> tilePoints_;
+	std::vector<Integer> tileCorePoints_;
+	std::vector<Integer> tileBoundaryPoints_;
+
+	std::vector<Integer> labels_;
+};
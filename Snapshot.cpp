@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Snapshot.h"
+#include "Neighbours.h"
+
+namespace
+{
+	/* Maps the whole file read only, returns nullptr on failure. */
+	const std::byte* mapFile(const std::string& path, std::size_t& size)
+	{
+#ifdef _WIN32
+		const auto file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER fileSize{};
+		const auto mapping{ GetFileSizeEx(file, &fileSize) && fileSize.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr };
+		CloseHandle(file);
+
+		if (!mapping)
+			return nullptr;
+
+		const auto* data{ static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) };
+		CloseHandle(mapping);
+
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+		return data;
+#else
+		const auto file{ ::open(path.c_str(), O_RDONLY) };
+
+		if (file < 0)
+			return nullptr;
+
+		struct stat status {};
+
+		if (::fstat(file, &status) < 0 || !status.st_size)
+		{
+			::close(file);
+			return nullptr;
+		}
+
+		auto* data{ ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0) };
+		::close(file);
+
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		size = static_cast<std::size_t>(status.st_size);
+		return static_cast<const std::byte*>(data);
+#endif
+	}
+
+	void unmapFile(const std::byte* data, const std::size_t size) noexcept
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		::munmap(const_cast<std::byte*>(data), size);
+#endif
+	}
+}
+
+template<class Metric>
+SpatialSnapshot<Metric>::SpatialSnapshot(const std::string& path)
+{
+	data_ = mapFile(path, size_);
+
+	if (!data_)
+	{
+		std::cout << std::format("\nFile {} can't be mapped. Snapshot wasn't opened...\n", path);
+		return;
+	}
+
+	const auto* header{ reinterpret_cast<const SnapshotHeader*>(data_) };
+
+	auto section = [&](const std::uint64_t offset, const std::uint64_t count, const std::size_t elementSize)
+	{
+		return offset % 64 == 0 && offset <= size_ && count <= (size_ - offset) / elementSize;
+	};
+
+	const auto isValid{ size_ >= sizeof(SnapshotHeader) &&
+		std::equal(std::begin(header->magic), std::end(header->magic), std::begin(SnapshotHeader::expectedMagic)) &&
+		header->version == SnapshotHeader::currentVersion && header->byteOrder == SnapshotHeader::expectedByteOrder &&
+		header->metric == Metric::id && header->fileSize == size_ &&
+		section(header->pointsOffset, header->points, sizeof(Point)) &&
+		section(header->labelsOffset, header->points, sizeof(std::uint32_t)) &&
+		section(header->orderOffset, header->points, sizeof(std::uint32_t)) &&
+		section(header->cellKeysOffset, header->cells, sizeof(std::uint64_t)) &&
+		section(header->cellStartsOffset, header->engine == Engine::Chunks ? header->cells + 1 : 0, sizeof(std::uint32_t)) };
+
+	/* The chunk starts index order, so they must not decrease nor pass the points (one pass over cells + 1 values). */
+	auto validStarts = [&]()
+	{
+		if (header->engine != Engine::Chunks)
+			return true;
+
+		const auto* starts{ reinterpret_cast<const std::uint32_t*>(data_ + header->cellStartsOffset) };
+
+		for (std::uint64_t cell{ 0 }; cell < header->cells; ++cell)
+			if (starts[cell] > starts[cell + 1])
+				return false;
+
+		return starts[header->cells] <= header->points;
+	};
+
+	if (!isValid || !validStarts())
+	{
+		std::cout << std::format("\nFile {} is not a snapshot of this version and metric. Snapshot wasn't opened...\n", path);
+		close();
+		return;
+	}
+
+	header_ = header;
+	points_ = { reinterpret_cast<const Point*>(data_ + header->pointsOffset), header->points };
+	labels_ = { reinterpret_cast<const std::uint32_t*>(data_ + header->labelsOffset), header->points };
+	order_ = { reinterpret_cast<const std::uint32_t*>(data_ + header->orderOffset), header->points };
+	cellKeys_ = { reinterpret_cast<const std::uint64_t*>(data_ + header->cellKeysOffset), header->cells };
+	cellStarts_ = { reinterpret_cast<const std::uint32_t*>(data_ + header->cellStartsOffset), header->engine == Engine::Chunks ? header->cells + 1 : 0 };
+}
+
+template<class Metric>
+SpatialSnapshot<Metric>::SpatialSnapshot(SpatialSnapshot&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+template<class Metric>
+SpatialSnapshot<Metric>& SpatialSnapshot<Metric>::operator=(SpatialSnapshot&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+
+		header_ = std::exchange(other.header_, nullptr);
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+		points_ = std::exchange(other.points_, {});
+		labels_ = std::exchange(other.labels_, {});
+		order_ = std::exchange(other.order_, {});
+		cellKeys_ = std::exchange(other.cellKeys_, {});
+		cellStarts_ = std::exchange(other.cellStarts_, {});
+	}
+
+	return *this;
+}
+
+template<class Metric>
+SpatialSnapshot<Metric>::~SpatialSnapshot()
+{
+	close();
+}
+
+template<class Metric>
+void SpatialSnapshot<Metric>::close(void) noexcept
+{
+	if (data_)
+		unmapFile(data_, size_);
+
+	header_ = nullptr;
+	data_ = nullptr;
+	size_ = 0;
+}
+
+template<class Metric>
+bool SpatialSnapshot<Metric>::isOpen(void) const noexcept
+{
+	return header_;
+}
+
+template<class Metric>
+Integer SpatialSnapshot<Metric>::size(void) const noexcept
+{
+	return header_ ? static_cast<Integer>(header_->points) : 0;
+}
+
+template<class Metric>
+Integer SpatialSnapshot<Metric>::clusters(void) const noexcept
+{
+	return header_ ? static_cast<Integer>(header_->clusters) : 0;
+}
+
+template<class Metric>
+double SpatialSnapshot<Metric>::scale(void) const noexcept
+{
+	return header_ ? header_->scale : 0.0;
+}
+
+template<class Metric>
+Engine SpatialSnapshot<Metric>::engine(void) const noexcept
+{
+	return header_ ? header_->engine : Engine::ConnectedComponents;
+}
+
+template<class Metric>
+std::span<const Point> SpatialSnapshot<Metric>::points(void) const noexcept
+{
+	return points_;
+}
+
+template<class Metric>
+std::span<const std::uint32_t> SpatialSnapshot<Metric>::labels(void) const noexcept
+{
+	return labels_;
+}
+
+template<class Metric>
+template<class Visitor>
+bool SpatialSnapshot<Metric>::visitNeighbours(const Point& point, Visitor&& visitor) const
+{
+	if (!header_)
+		return true;
+
+	const NeighbourGrid grid{ header_->bounds.minX, header_->bounds.minY, header_->chunkLength, header_->rows, header_->columns };
+
+	return Neighbours::visit<Metric>(point, header_->scale, header_->engine == Engine::Chunks ? &grid : nullptr, order_,
+		[this](const std::uint32_t index) -> const Point&
+		{
+			/* Order entries are not checked at open (that would read the whole section), a bad one is never within scale. */
+			static const Point invalidPoint{ std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN() };
+
+			return index < points_.size() ? points_[index] : invalidPoint;
+		},
+		[this](const std::uint64_t row, const std::uint64_t column, auto&& visitPoint)
+		{
+			const auto key{ row * header_->columns + column };
+			const auto position{ std::lower_bound(cellKeys_.begin(), cellKeys_.end(), key) };
+
+			if (position == cellKeys_.end() || *position != key)
+				return true;
+
+			const auto cell{ position - cellKeys_.begin() };
+
+			for (auto index{ cellStarts_[cell] }; index < cellStarts_[cell + 1]; ++index)
+				if (!visitPoint(order_[index]))
+					return false;
+
+			return true;
+		},
+		[&visitor](const std::uint32_t index) { return visitor(static_cast<Integer>(index)); });
+}
+
+template<class Metric>
+std::vector<Integer> SpatialSnapshot<Metric>::neighbours(const Point& point) const
+{
+	std::vector<Integer> result;
+
+	visitNeighbours(point, [&result](const Integer index) { result.push_back(index); return true; });
+
+	return result;
+}
+
+template<class Metric>
+Integer SpatialSnapshot<Metric>::clusterOf(const Point& point) const
+{
+	Integer label{ maxValue };
+
+	visitNeighbours(point, [&](const Integer index) { label = labels_[index]; return false; });
+
+	return label;
+}
+
+template class SpatialSnapshot<Euclidean>;
+template class SpatialSnapshot<Chebyshev>;
+template class SpatialSnapshot<Manhattan>;
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstdint>
+
+#include "SpatialStruct.h"
+
+/*
+ * Binary snapshot of a computed SpatialStruct, written by SpatialStruct::save and mapped by SpatialStruct::open.
+ *
+ * Layout: the header, then every section aligned to 64 bytes:
+ * points (Point[points]), labels (uint32[points], the index of a point of the cluster),
+ * order (uint32[points], the points grouped by chunk, or sorted by x without chunks),
+ * and for chunks only: cell keys (uint64[cells], row * columns + column of the non empty chunks)
+ * and cell starts (uint32[cells + 1], into order).
+ * The file is used in place, so a restarted process can answer right after the mapping.
+ */
+
+struct SnapshotHeader
+{
+	static constexpr char expectedMagic[8]{ 'R', '2', 'D', 'C', 'S', 'N', 'A', 'P' };
+	static constexpr std::uint32_t currentVersion{ 1 };
+	static constexpr std::uint32_t expectedByteOrder{ 0x01020304 };
+
+	char magic[8]{};
+	std::uint32_t version{ currentVersion };
+	std::uint32_t byteOrder{ expectedByteOrder };
+	std::uint32_t metric{ 0 };
+	Engine engine{ Engine::ConnectedComponents };
+
+	std::uint64_t points{ 0 };
+	std::uint64_t clusters{ 0 };
+	std::uint64_t cells{ 0 };
+	std::uint64_t rows{ 0 };
+	std::uint64_t columns{ 0 };
+
+	double scale{ 0.0 };
+	double chunkLength{ 0.0 };
+	Bounds bounds{};
+
+	std::uint64_t pointsOffset{ 0 };
+	std::uint64_t labelsOffset{ 0 };
+	std::uint64_t orderOffset{ 0 };
+	std::uint64_t cellKeysOffset{ 0 };
+	std::uint64_t cellStartsOffset{ 0 };
+	std::uint64_t fileSize{ 0 };
+};
+
+template<class Metric = Euclidean>
+class SpatialSnapshot
+{
+public:
+
+	SpatialSnapshot() = default;
+
+	explicit SpatialSnapshot(const std::string& path);
+
+	SpatialSnapshot(const SpatialSnapshot&) = delete;
+
+	SpatialSnapshot& operator=(const SpatialSnapshot&) = delete;
+
+	SpatialSnapshot(SpatialSnapshot&& other) noexcept;
+
+	SpatialSnapshot& operator=(SpatialSnapshot&& other) noexcept;
+
+	~SpatialSnapshot();
+
+	bool isOpen(void) const noexcept;
+
+	Integer size(void) const noexcept;
+
+	Integer clusters(void) const noexcept;
+
+	double scale(void) const noexcept;
+
+	Engine engine(void) const noexcept;
+
+	std::span<const Point> points(void) const noexcept;
+
+	std::span<const std::uint32_t> labels(void) const noexcept;
+
+	/* Indices of the snapshot points within scale of point. */
+	std::vector<Integer> neighbours(const Point& point) const;
+
+	/* Label of a cluster that point would join, or maxValue. */
+	Integer clusterOf(const Point& point) const;
+
+private:
+
+	template<class Visitor>
+	bool visitNeighbours(const Point& point, Visitor&& visitor) const;
+
+	void close(void) noexcept;
+
+	const SnapshotHeader* header_{ nullptr };
+	const std::byte* data_{ nullptr };
+	std::size_t size_{ 0 };
+
+	std::span<const Point> points_;
+	std::span<const std::uint32_t> labels_;
+	std::span<const std::uint32_t> order_;
+	std::span<const std::uint64_t> cellKeys_;
+	std::span<const std::uint32_t> cellStarts_;
+};
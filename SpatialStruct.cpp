@@ -1,16 +1,19 @@
-#define _USE_MATH_DEFINES
-
 #include <unordered_map>
+#include <atomic>
 #include <execution>
 #include <algorithm>
 #include <iomanip>
+#include <random>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <format>
 
 #include "SpatialStruct.h"
+#include "Snapshot.h"
+#include "Neighbours.h"
 
-static const auto availableThreads = std::jthread::hardware_concurrency() / 2;
+static const auto availableThreads = std::max(std::jthread::hardware_concurrency() / 2, 1U);
 
 template<class T> requires std::is_arithmetic_v<T>
 static std::string formatNumber(T value)
@@ -21,14 +24,16 @@ static std::string formatNumber(T value)
 	return ss.str();
 }
 
-void SpatialStruct::printMessage(const std::string_view message) const
+template<class Metric>
+void SpatialStruct<Metric>::printMessage(const std::string_view message) const
 {
 	if (printMessages_)
 		std::cout << "\n" << message << "\n";
 }
 
+template<class Metric>
 template<char parent>
-inline Integer SpatialStruct::getParent(const Integer x) const noexcept
+inline Integer SpatialStruct<Metric>::getParent(const Integer x) const noexcept
 {
 	Integer localX{ x };
 	auto temp = localX;
@@ -49,8 +54,9 @@ inline Integer SpatialStruct::getParent(const Integer x) const noexcept
 	}
 }
 
-SpatialStruct::SpatialStruct(std::vector<Point>& data, const double scale, const bool verbose) :
-	printMessages_{ verbose }, scale_{ scale }, minusScale_{ -scale }, scaleSquared_{ scale * scale }, Points_{ data }
+template<class Metric>
+SpatialStruct<Metric>::SpatialStruct(std::vector<Point>& data, const double scale, const bool verbose) :
+	printMessages_{ verbose }, scale_{ scale }, minusScale_{ -scale }, distanceThreshold_{ Metric::threshold(scale) }, Points_{ data }
 {
 	if (!data.size() || data.size() >= maxValue || scale <= 0.0L || !std::isfinite(scale * scale))
 	{
@@ -58,26 +64,84 @@ SpatialStruct::SpatialStruct(std::vector<Point>& data, const double scale, const
 		return;
 	}
 
-	initialize(data, scale);
-	initialized_ = true;
+	initialized_ = initialize(data, scale);
 }
 
-void SpatialStruct::initialize(const std::vector<Point>& data, const double scale)
+template<class Metric>
+SpatialStruct<Metric>::SpatialStruct(std::vector<Point>& data, const double scale, const Bounds& bounds, const bool verbose) :
+	printMessages_{ verbose }, scale_{ scale }, minusScale_{ -scale }, distanceThreshold_{ Metric::threshold(scale) }, Points_{ data }
 {
-	const auto& [minXP, maxXP] = std::minmax_element(std::execution::par_unseq, data.cbegin(), data.cend());
-	const auto& [minYP, maxYP] = std::minmax_element(std::execution::par_unseq, data.cbegin(), data.cend(), 
-									[](const Point& a, const Point& b) { return a.y() < b.y(); });
+	if (!data.size() || data.size() >= maxValue || scale <= 0.0L || !std::isfinite(scale * scale) ||
+		!(bounds.minX <= bounds.maxX) || !(bounds.minY <= bounds.maxY))
+	{
+		std::cout << "\nScale lenght is not positive or is too big, or point set is empty or too big, or bounds are empty. Structure wasn't created...\n";
+		return;
+	}
 
-	minX_ = (*minXP).x();
-	minY_ = (*minYP).y();
-	maxX_ = (*maxXP).x();
-	maxY_ = (*maxYP).y();
+	initialized_ = initializeGrid(bounds, scale);
+}
+
+template<class Metric>
+SpatialStruct<Metric>::SpatialStruct(std::vector<Point>& data, const double scale, const Engine engine, const bool verbose) :
+	printMessages_{ verbose }, scale_{ scale }, minusScale_{ -scale }, distanceThreshold_{ Metric::threshold(scale) }, Points_{ data }
+{
+	if (!data.size() || data.size() >= maxValue || scale <= 0.0L || !std::isfinite(scale * scale))
+	{
+		std::cout << "\nScale lenght is not positive or is too big, or point set is empty or too big. Structure wasn't created...\n";
+		return;
+	}
+
+	if (engine == Engine::Adaptive)
+		initialized_ = initializeTree(computeBounds(data));
+	else if (engine == Engine::ConnectedComponents)
+	{
+		printMessage("Will use the Connecteed Components Method.");
+
+		initialized_ = true;
+	}
+	else
+		initialized_ = initialize(data, scale);
+}
+
+template<class Metric>
+Bounds SpatialStruct<Metric>::computeBounds(const std::vector<Point>& data)
+{
+	return std::transform_reduce(std::execution::par_unseq, data.cbegin(), data.cend(), Bounds{},
+		[](const Bounds& a, const Bounds& b)
+		{
+			return Bounds{ std::min(a.minX, b.minX), std::max(a.maxX, b.maxX), std::min(a.minY, b.minY), std::max(a.maxY, b.maxY) };
+		},
+		[](const Point& point)
+		{
+			return Bounds{ point.x(), point.x(), point.y(), point.y() };
+		});
+}
+
+template<class Metric>
+bool SpatialStruct<Metric>::initialize(const std::vector<Point>& data, const double scale)
+{
+	if (!initializeGrid(computeBounds(data), scale))
+		return false;
+
+	insertPoints(0, static_cast<Integer>(data.size()));
+
+	printMessage(std::format("Structure was created for {} points.", formatNumber(data.size())));
+
+	return true;
+}
+
+template<class Metric>
+bool SpatialStruct<Metric>::initializeGrid(const Bounds& bounds, const double scale)
+{
+	minX_ = bounds.minX;
+	minY_ = bounds.minY;
+	maxX_ = bounds.maxX;
+	maxY_ = bounds.maxY;
 
 	if (!std::isfinite(std::pow(maxX_ - minX_, 2) + std::pow(maxY_ - minY_, 2)))
 	{
 		std::cout << "\nNumber range is too big. Result may be incorrect. Structure wasn't created...\n";
-		initialized_ = false;
-		return;
+		return false;
 	}
 
 	printMessage(std::format("Minimum X: {}", formatNumber(minX_)));
@@ -85,15 +149,15 @@ void SpatialStruct::initialize(const std::vector<Point>& data, const double scal
 	printMessage(std::format("Minimum Y: {}", formatNumber(minY_)));
 	printMessage(std::format("Maximum Y: {}", formatNumber(maxY_)));
 
-	const auto chunkLength{ scale / M_SQRT2 };
-	const auto tmpRows{ ceil((maxY_ - minY_) / chunkLength) };
-	const auto tmpColumns{ ceil((maxX_ - minX_) / chunkLength) };
+	chunkLength_ = scale * Metric::cellFactor;
+	const auto tmpRows{ std::max(ceil((maxY_ - minY_) / chunkLength_), 1.0) };
+	const auto tmpColumns{ std::max(ceil((maxX_ - minX_) / chunkLength_), 1.0) };
 
 	printMessage(std::format("Scale length : {}", formatNumber(scale)));
 
 	if (tmpRows < threshold_ / tmpColumns)
 	{
-		useChunks_ = true;
+		engine_ = Engine::Chunks;
 		rows_ = static_cast<Integer>(tmpRows);
 		columns_ = static_cast<Integer>(tmpColumns);
 		rowsMinusOne_ = rows_ - 1;
@@ -105,38 +169,179 @@ void SpatialStruct::initialize(const std::vector<Point>& data, const double scal
 	else
 	{
 		printMessage("Will use the Connecteed Components Method.");
-		printMessage(std::format("Structure was created for {} points.", formatNumber(data.size())));
 
-		return;
+		return true;
 	}
 
-	indexList_.resize(data.size(), maxValue);
-	Chunk::setIndices(indexList_);
+	/* The arrays are resized without initialization, then filled by several threads (see Memory.h). */
+	indexList_.resize(Points_.size());
+	parallelFill(indexList_, maxValue);
 
 	Integer numberOfChunks{ rows_ * columns_ };
 
 	chunks_.resize(numberOfChunks);
+	parallelFill(chunks_, Chunk{});
+
+	chunkParents_.resize(numberOfChunks);
+	parallelIota(chunkParents_);
 
-	Integer index{ 0 };
+	return true;
+}
 
-	for (const auto& point : data)
+template<class Metric>
+bool SpatialStruct<Metric>::initializeTree(const Bounds& bounds)
+{
+	minX_ = bounds.minX;
+	minY_ = bounds.minY;
+	maxX_ = bounds.maxX;
+	maxY_ = bounds.maxY;
+
+	if (!std::isfinite(std::pow(maxX_ - minX_, 2) + std::pow(maxY_ - minY_, 2)))
 	{
-		Integer y { static_cast<decltype(y)>((point.x() - minX_) / chunkLength) };
-		Integer x { static_cast<decltype(x)>((point.y() - minY_) / chunkLength) };
+		std::cout << "\nNumber range is too big. Result may be incorrect. Structure wasn't created...\n";
+		return false;
+	}
+
+	engine_ = Engine::Adaptive;
+
+	const auto N{ static_cast<Integer>(Points_.size()) };
+
+	/* Median splits halve the points, so below this depth every node has at most leafSize_ points. */
+	Integer depth{ 0 };
+
+	while (((N - 1) >> depth) + 1 > leafSize_)
+		++depth;
+
+	indices_.resize(N);
+	parents_.resize(N);
+
+	parallelIota(indices_);
+	parallelIota(parents_);
+
+	tree_.resize((Integer{ 2 } << depth) - 1);
+
+	printMessage(std::format("Will use the Adaptive Tree Method.\n\nTree depth: {}", formatNumber(depth)));
+
+	buildTree(0, 0, N, 0);
+
+	printMessage(std::format("Structure was created for {} points.", formatNumber(N)));
+
+	return true;
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::buildTree(const Integer node, const Integer begin, const Integer end, const Integer depth)
+{
+	auto& treeNode{ tree_[node] };
+
+	treeNode.begin = begin;
+	treeNode.end = end;
+
+	for (Integer index{ begin }; index < end; ++index)
+	{
+		const auto& point{ Points_[indices_[index]] };
+
+		treeNode.box.minX = std::min(treeNode.box.minX, point.x());
+		treeNode.box.maxX = std::max(treeNode.box.maxX, point.x());
+		treeNode.box.minY = std::min(treeNode.box.minY, point.y());
+		treeNode.box.maxY = std::max(treeNode.box.maxY, point.y());
+	}
+
+	const auto width{ treeNode.box.maxX - treeNode.box.minX };
+	const auto height{ treeNode.box.maxY - treeNode.box.minY };
+
+	/*
+	 * Dense enough: one component, without comparing its points.
+	 * It is still split, so leaves stay small for the pairs with other nodes.
+	 */
+	if (node && tree_[(node - 1) / 2].whole)
+		treeNode.whole = true;
+	else if (Metric::within(width, height, distanceThreshold_))
+	{
+		treeNode.whole = true;
+		std::fill(parents_.begin() + begin, parents_.begin() + end, begin);
+	}
+
+	if (end - begin <= leafSize_ || 2 * node + 2 >= tree_.size())
+	{
+		treeNode.leaf = true;
+		return;
+	}
+
+	const auto middle{ begin + (end - begin) / 2 };
+
+	if (width >= height)
+		std::nth_element(indices_.begin() + begin, indices_.begin() + middle, indices_.begin() + end,
+						 [this](Integer a, Integer b) { return Points_[a].x() < Points_[b].x(); });
+	else
+		std::nth_element(indices_.begin() + begin, indices_.begin() + middle, indices_.begin() + end,
+						 [this](Integer a, Integer b) { return Points_[a].y() < Points_[b].y(); });
+
+	if ((Integer{ 1 } << depth) < availableThreads)
+	{
+		std::jthread left(&SpatialStruct::buildTree, this, 2 * node + 1, begin, middle, depth + 1);
+
+		buildTree(2 * node + 2, middle, end, depth + 1);
+	}
+	else
+	{
+		buildTree(2 * node + 1, begin, middle, depth + 1);
+		buildTree(2 * node + 2, middle, end, depth + 1);
+	}
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::insertPoints(const Integer fromIndex, const Integer toIndex)
+{
+	if (engine_ != Engine::Chunks)
+		return;
+
+	for (Integer index{ fromIndex }; index < toIndex; ++index)
+	{
+		const auto& point{ Points_[index] };
+
+		Integer y { static_cast<decltype(y)>((point.x() - minX_) / chunkLength_) };
+		Integer x { static_cast<decltype(x)>((point.y() - minY_) / chunkLength_) };
 
 		x -= (x == rows_);
 		y -= (y == columns_);
 
-		chunks_[static_cast<std::vector<Chunk, std::allocator<Chunk>>::size_type>(x) * columns_ + y].addIndex(index++);
+		chunks_[static_cast<HugeVector<Chunk>::size_type>(x) * columns_ + y].addIndex(index, indexList_);
 	}
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::mergeBelow(const double y)
+{
+	if (!initialized_ || engine_ != Engine::Chunks || clusters_ || y <= minY_)
+		return;
 
-	chunkParents_.resize(numberOfChunks, 0U);
-	std::iota(chunkParents_.begin(), chunkParents_.end(), 0U);
+	/*
+	 * Rows under the row of y can't receive more points,
+	 * and a chunk is visited only after the rows its stencil reaches are complete.
+	 */
+	const auto completeRows{ std::min(static_cast<Integer>((y - minY_) / chunkLength_), rowsMinusOne_) };
 
-	printMessage(std::format("Structure was created for {} points.", formatNumber(data.size())));
+	if (completeRows <= Stencil<Metric>::rows)
+		return;
+
+	const auto lastRow{ completeRows - Stencil<Metric>::rows };
+
+	for (Integer index{ mergedRows_ * columns_ }; index < lastRow * columns_; ++index)
+		if (!chunks_[index].isEmpty())
+			visitChunk(index);
+
+	mergedRows_ = std::max(mergedRows_, lastRow);
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::restartMerge(void) noexcept
+{
+	mergedRows_ = 0;
 }
 
-Integer SpatialStruct::computeClusters(const bool byXY)
+template<class Metric>
+Integer SpatialStruct<Metric>::computeClusters(const bool byXY)
 {
 	if (!initialized_)
 		return 0;
@@ -144,13 +349,17 @@ Integer SpatialStruct::computeClusters(const bool byXY)
 	if (clusters_)
 		return clusters_;
 
-	if (useChunks_)
+	if (engine_ == Engine::Chunks)
 	{
 		if (const auto chunks = rows_ * columns_; chunks < 1'000'000 || chunks / Points_.size() > 10)
 			chunkedSpaceMethod<'P'>();
 		else
 			chunkedSpaceMethod();
 	}
+	else if (engine_ == Engine::Adaptive)
+	{
+		adaptiveTreeMethod();
+	}
 	else
 	{
 		connectedComponentsMethod(byXY);
@@ -159,116 +368,344 @@ Integer SpatialStruct::computeClusters(const bool byXY)
 	return clusters_;
 }
 
-bool SpatialStruct::checkDistance(const Point& A, const Point& B) const noexcept
+template<class Metric>
+ClusterEstimate SpatialStruct<Metric>::estimateClusters(const Integer samples, const double confidence, const std::uint64_t seed)
 {
-	const long double xd{ A.x() - B.x() };
-	if (xd > scale_ || xd < minusScale_)
-		return false;
-	const long double yd{ A.y() - B.y() };
-	return minusScale_ <= yd && yd <= scale_ && xd * xd + yd * yd <= scaleSquared_;
-}
+	if (!initialized_)
+		return {};
 
-bool SpatialStruct::compareChunkPoints(const Chunk& A, const Chunk& B) const noexcept
-{
-	for (const auto indexA : A)
-	{
-		const auto& pointA{ Points_[indexA] };
+	const auto N{ static_cast<Integer>(Points_.size()) };
+	const auto sampleCount{ std::max(samples, Integer{ 1 }) };
 
-		for (const auto indexB : B)
-			if (checkDistance(pointA, Points_[indexB]))
-				return true;
-	}
+	auto exactCount = [this, N]
+	{
+		const auto clusters{ static_cast<double>(computeClusters()) };
+		return ClusterEstimate{ clusters, clusters, clusters, 0.0, N, true };
+	};
 
-	return false;
-}
+	/* The k-d tree gives the exact count faster than the points can be hashed into cells. */
+	if (engine_ == Engine::Adaptive || clusters_ || sampleCount >= N)
+		return exactCount();
 
-template<char Execution>
-std::vector<std::pair<Integer, Integer>> SpatialStruct::neighbourChunks(const Integer index) const
-{
-	const Integer i{ index / columns_ };
-	const Integer j{ index % columns_ };
+	/*
+	 * The count is the sum over the points of 1 / (points of its cell * cells of its component),
+	 * so it's N times the mean of that value over uniformly sampled points.
+	 * The search of a component stops past estimateCellCap_ cells: such a sample adds 0, and all of them together add 1
+	 * (there's at least one such component), so the estimate can only be lower than the count,
+	 * by at most 1 / (points of its cell * estimateCellCap_) per sample.
+	 */
+	using Cell = std::pair<std::int64_t, std::int64_t>;
 
-	if (Execution == 'S')
+	struct CellHash
 	{
-		if (i == 0)
+		std::size_t operator()(const Cell& cell) const noexcept
 		{
-			if (j == 0)
-				return { {0, 1}, {1, 0}, {1, 1}, {0, 2}, {2, 0}, {2, 1}, {1, 2} };
-			else if (j == columnsMinusOne_)
-				return { {1, j}, {1, j - 1}, {2, j}, {1, j - 2}, {2, j - 1} };
-			else [[likely]]
-				return { {0, j + 1}, {1, j}, {1, j - 1}, {1, j - 2}, {1, j + 1}, 
-						{0, j + 2}, {1, j + 2}, {2, j}, {2, j - 1}, {2, j + 1} };
+			const auto hash{ static_cast<std::uint64_t>(cell.first) * 0x9E3779B97F4A7C15ULL ^ static_cast<std::uint64_t>(cell.second) * 0xC2B2AE3D27D4EB4FULL };
+			return static_cast<std::size_t>(hash ^ (hash >> 32));
 		}
-		else if (i == rowsMinusOne_)
+	};
+
+	/* Without chunks, cells of the chunk size are hashed into buckets, in one pass over the points. */
+	const bool hashed{ engine_ == Engine::ConnectedComponents };
+
+	constexpr double largestCell{ 4.0e18 };
+
+	Bounds bounds{ minX_, maxX_, minY_, maxY_ };
+	double cellLength{ chunkLength_ };
+
+	if (hashed)
+	{
+		bounds = computeBounds(Points_);
+		cellLength = scale_ * Metric::cellFactor;
+
+		/* Cells past the 64 bit range would be merged, which their points are not. */
+		if (!(std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY) / cellLength < largestCell))
+			return exactCount();
+	}
+
+	auto cellOf = [&](const Point& point)
+	{
+		Cell cell{ static_cast<std::int64_t>(std::min((point.y() - bounds.minY) / cellLength, largestCell)),
+				   static_cast<std::int64_t>(std::min((point.x() - bounds.minX) / cellLength, largestCell)) };
+
+		if (!hashed)
 		{
-			if (j == columnsMinusOne_)
-				return {};
-			else [[likely]]
-				return { {i, j + 1}, {i, j + 2} };
+			cell.first -= std::cmp_equal(cell.first, rows_);
+			cell.second -= std::cmp_equal(cell.second, columns_);
 		}
-		else [[likely]]
+
+		return cell;
+	};
+
+	const Integer buckets{ std::max(N / 2, Integer{ 1 }) };
+
+	/*
+	 * Point indices of every bucket, from bucketStarts[bucket] to bucketStarts[bucket + 1].
+	 * Only the indices are kept (12 bytes per point with the starts), the cells are computed again when a bucket is read.
+	 */
+	HugeVector<Integer> bucketStarts;
+	HugeVector<Integer> bucketPoints;
+
+	if (hashed)
+	{
+		auto bucketOf = [&](const Point& point) { return CellHash{}(cellOf(point)) % buckets; };
+
+		bucketStarts.resize(buckets + 1);
+		parallelFill(bucketStarts, Integer{ 0 });
+
+		ParallelMemory::forRanges(0, N, [&](const std::size_t first, const std::size_t last)
 		{
-			if (j == 0)
-				return { {i + 1, 0}, {i + 1, 1}, {i, 1}, {i + 2, 0}, {i + 2, 1}, {i, 2}, {i + 1, 2} };
-			else if (j == columnsMinusOne_)
-				return { {i + 1, j}, {i + 1, j - 1}, {i + 2, j}, {i + 2, j - 1},  {i + 1, j - 2} };
-			else [[likely]]
-				return { {i, j + 1}, {i + 1, j}, {i + 1, j - 1}, {i + 1, j + 1}, {i + 2, j}, {i, j + 2}, 
-						{i + 2, j - 1}, {i + 2, j + 1}, {i + 1, j + 2}, {i + 1, j - 2} };
-		}
+			for (auto index{ first }; index < last; ++index)
+				std::atomic_ref(bucketStarts[bucketOf(Points_[index])]).fetch_add(1, std::memory_order_relaxed);
+		});
+
+		/* After the scan every start is the end of its bucket, and the scatter moves it back to the beginning. */
+		std::inclusive_scan(bucketStarts.begin(), bucketStarts.end(), bucketStarts.begin());
+		bucketPoints.resize(N);
+
+		ParallelMemory::forRanges(0, N, [&](const std::size_t first, const std::size_t last)
+		{
+			for (auto index{ first }; index < last; ++index)
+				bucketPoints[std::atomic_ref(bucketStarts[bucketOf(Points_[index])]).fetch_sub(1, std::memory_order_relaxed) - 1] = static_cast<Integer>(index);
+		});
 	}
-	else
+
+	auto cellPoints = [&](const Cell& cell, std::vector<Integer>& points)
 	{
-		if (i == 0)
+		points.clear();
+
+		if (cell.first < 0 || cell.second < 0)
+			return;
+
+		if (!hashed)
 		{
-			if (j == 0)
-				return { {0, 1}, {1, 0}, {1, 1}, {0, 2}, {2, 0}, {2, 1}, {1, 2} };
-			else if (j == columnsMinusOne_)
-				return { {1, j}, {1, j - 1}, {2, j}, {1, j - 2}, {2, j - 1}, {0, j - 1}, {0, j - 2} };
-			else [[likely]]
-				return { {0, j + 1}, {1, j}, {1, j - 1}, {1, j - 2}, {1, j + 1}, {0, j + 2}, {1, j + 2}, {2, j}, 
-						{2, j - 1}, {2, j + 1}, {0, j - 1}, {0, j - 2} };
+			if (std::cmp_greater_equal(cell.first, rows_) || std::cmp_greater_equal(cell.second, columns_))
+				return;
+
+			for (const auto index : chunks_[static_cast<Integer>(cell.first) * columns_ + static_cast<Integer>(cell.second)].points(indexList_))
+				points.push_back(index);
+
+			return;
 		}
-		else if (i == rowsMinusOne_)
+
+		const auto bucket{ CellHash{}(cell) % buckets };
+
+		for (auto position{ bucketStarts[bucket] }; position < bucketStarts[bucket + 1]; ++position)
+			if (cellOf(Points_[bucketPoints[position]]) == cell)
+				points.push_back(bucketPoints[position]);
+	};
+
+	std::vector<Integer> sampled(sampleCount);
+	std::mt19937_64 generator{ seed };
+	std::uniform_int_distribution<Integer> distribution{ 0, N - 1 };
+
+	for (auto& index : sampled)
+		index = distribution(generator);
+
+	std::vector<double> values(sampleCount);
+	std::vector<double> cutValues(sampleCount);
+
+	/* Every cell a search reaches is in the same component, so it has the same number of cells, or 0 if the search was cut. */
+	std::unordered_map<Cell, Integer, CellHash> componentCells;
+	std::mutex componentMutex;
+
+	componentCells.reserve(static_cast<std::size_t>(sampleCount) * estimateCellCap_);
+
+	auto threadLambda = [&](const Integer k)
+	{
+		/* The queue is also the set of visited cells, it's short enough for a linear search. */
+		std::vector<Cell> queue;
+		std::vector<Integer> pointsA;
+		std::vector<Integer> pointsB;
+
+		queue.reserve(estimateCellCap_);
+
+		for (Integer sample{ k }; sample < sampleCount; sample += availableThreads)
 		{
-			if (j == 0)
-				return { {i - 1, 0}, {i - 2, 0}, {i - 1, 1}, {i - 2, 1}, {i - 1, 2} , {i, j + 1}, {i, j + 2} };
-			else if (j == columnsMinusOne_)
-				return { {i, j - 1}, {i, j - 2}, {i - 1, j - 1}, {i - 1, j - 2}, {i - 1, j}, {i - 2, j}, {i - 2, j - 1} };
-			else [[likely]]
-				return { {i - 1, j - 2}, {i - 1, j - 1}, {i - 1, j}, {i - 1, j + 1}, {i - 1, j + 2}, {i - 2, j - 1}, 
-						{i - 2, j}, {i - 2, j + 1}, {i, j - 1}, {i, j - 2}, {i, j + 1}, {i, j + 2} };
+			const auto start{ cellOf(Points_[sampled[sample]]) };
+
+			cellPoints(start, pointsA);
+
+			const auto startPoints{ static_cast<double>(pointsA.size()) };
+
+			/* Cells of the component of the sample, 0 if it's bigger than the cap, maxValue while it isn't known. */
+			Integer cells{ maxValue };
+
+			auto findCells = [&](const Cell& cell)
+			{
+				std::lock_guard lock(componentMutex);
+
+				if (const auto found{ componentCells.find(cell) }; found != componentCells.end())
+					cells = found->second;
+
+				return cells != maxValue;
+			};
+
+			if (!findCells(start))
+			{
+				queue.assign(1, start);
+
+				bool cut{ false };
+
+				for (Integer head{ 0 }; head < queue.size() && !cut && cells == maxValue; ++head)
+				{
+					const auto [row, column] = queue[head];
+
+					if (head)
+						cellPoints(queue[head], pointsA);
+
+					for (const auto& [rowOffset, columnOffset] : Stencil<Metric>::template offsets<false>)
+					{
+						const Cell neighbour{ row + rowOffset, column + columnOffset };
+
+						if (std::find(queue.cbegin(), queue.cend(), neighbour) != queue.cend())
+							continue;
+
+						cellPoints(neighbour, pointsB);
+
+						if (pointsB.empty() || !comparePoints(pointsA, pointsB))
+							continue;
+
+						/* A neighbour searched before is in the same component, so its number of cells is the answer. */
+						if (findCells(neighbour))
+							break;
+
+						if (queue.size() == estimateCellCap_)
+						{
+							cut = true;
+							break;
+						}
+
+						queue.push_back(neighbour);
+					}
+				}
+
+				if (cells == maxValue)
+					cells = cut ? 0 : static_cast<Integer>(queue.size());
+
+				std::lock_guard lock(componentMutex);
+
+				for (const auto& cell : queue)
+					componentCells.emplace(cell, cells);
+			}
+
+			values[sample] = cells ? 1.0 / (startPoints * static_cast<double>(cells)) : 0.0;
+			cutValues[sample] = cells ? 0.0 : 1.0 / (startPoints * static_cast<double>(estimateCellCap_));
 		}
-		else [[likely]]
+	};
+
+	{
+		printMessage(std::format("Estimating clusters from {} samples, using {} threads...", formatNumber(sampleCount), formatNumber(availableThreads)));
+
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(availableThreads);
+
+		for (Integer index{ availableThreads }; index--;)
+			threadPool.emplace_back(threadLambda, index);
+	}
+
+	const auto mean{ std::reduce(values.cbegin(), values.cend()) / sampleCount };
+	const auto variance{ std::transform_reduce(values.cbegin(), values.cend(), 0.0, std::plus<>{},
+							[mean](const double value) { return (value - mean) * (value - mean); }) / std::max(sampleCount - 1, Integer{ 1 }) };
+
+	/* Normal quantile of the confidence, by bisection of erf. */
+	double low{ 0.0 };
+	double high{ 10.0 };
+
+	for (int iteration{ 0 }; iteration < 64; ++iteration)
+	{
+		const auto middle{ (low + high) / 2 };
+
+		if (std::erf(middle / std::sqrt(2.0)) < confidence)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	/* A single sample gives no spread, so its interval is every possible count. */
+	const auto halfWidth{ sampleCount > 1 ? high * std::sqrt(variance / sampleCount) * N : static_cast<double>(N) };
+	const auto cutBound{ std::reduce(cutValues.cbegin(), cutValues.cend()) / sampleCount * N };
+
+	/* A cut search means there's at least one component bigger than the cap. */
+	const auto bigComponents{ cutBound > 0.0 ? 1.0 : 0.0 };
+
+	ClusterEstimate result{};
+
+	result.estimate = mean * N + bigComponents;
+	result.biasBound = std::max(cutBound - bigComponents, 0.0);
+	result.lower = std::max(std::max(mean * N - halfWidth, 0.0) + bigComponents, 1.0);
+	result.upper = std::min(result.estimate + halfWidth + result.biasBound, static_cast<double>(N));
+	result.samples = sampleCount;
+
+	printMessage(std::format("Estimated clusters: {} ({} - {})", formatNumber(result.estimate), formatNumber(result.lower), formatNumber(result.upper)));
+
+	return result;
+}
+
+template<class Metric>
+template<class RangeA, class RangeB>
+bool SpatialStruct<Metric>::comparePoints(const RangeA& A, const RangeB& B) const noexcept
+{
+	/* The points of B are gathered in batches of coordinate arrays, for the packed test of anyWithin. */
+	constexpr Integer batchSize{ 64 };
+
+	alignas(64) double xs[batchSize];
+	alignas(64) double ys[batchSize];
+
+	auto batchBegin{ std::begin(B) };
+
+	while (batchBegin != std::end(B))
+	{
+		Integer size{ 0 };
+		auto batchEnd{ batchBegin };
+
+		for (; batchEnd != std::end(B) && size < batchSize; ++batchEnd, ++size)
 		{
-			if (j == 0)
-				return { {i - 1, 0}, {i - 2, 0}, {i - 1, 1}, {i - 2, 1}, {i - 1, 2}, {i + 1, 0}, {i + 1, 1}, {i, 1}, 
-						{i + 2, 0}, {i + 2, 1}, {i, 2}, {i + 1, 2} };
-			else if (j == columnsMinusOne_)
-				return { {i - 1, j}, {i - 2, j}, {i - 1, j - 1}, {i - 2, j - 1}, {i - 1, j - 2}, {i, j - 2}, {i, j - 1}, 
-						{i + 1, j}, {i + 1, j - 1}, {i + 2, j}, {i + 2, j - 1},  {i + 1, j - 2} };
-			else [[likely]]
-				return { {i, j - 1}, {i, j - 2}, {i - 1, j - 2}, {i - 1, j - 1}, {i - 1, j}, 
-						{i - 1, j + 1}, {i - 1, j + 2}, {i - 2, j - 1}, {i - 2, j}, {i - 2, j + 1},
-						{i, j + 1}, {i + 1, j}, {i + 1, j - 1}, {i + 1, j + 1}, {i + 2, j}, 
-						{i, j + 2}, {i + 2, j - 1}, {i + 2, j + 1}, {i + 1, j + 2}, {i + 1, j - 2 } };
+			const auto& pointB{ Points_[*batchEnd] };
+			xs[size] = pointB.x();
+			ys[size] = pointB.y();
 		}
+
+		for (const auto indexA : A)
+		{
+			const auto& pointA{ Points_[indexA] };
+
+			if (anyWithin<Metric>(xs, ys, size, pointA.x(), pointA.y(), distanceThreshold_))
+				return true;
+		}
+
+		batchBegin = batchEnd;
 	}
+
+	return false;
+}
+
+template<class Metric>
+bool SpatialStruct<Metric>::compareChunkPoints(const Chunk& A, const Chunk& B) const noexcept
+{
+	return comparePoints(A.points(indexList_), B.points(indexList_));
 }
 
+template<class Metric>
 template<char Execution>
-void SpatialStruct::visitChunk(const Integer index)
+void SpatialStruct<Metric>::visitChunk(const Integer index)
 {
+	const auto& chunk{ chunks_[index] };
+
+	const Integer i{ index / columns_ };
+	const Integer j{ index % columns_ };
+
+	/* Negative offsets wrap around, and are skipped with the ones past the last row or column. */
 	if (Execution == 'S')
 	{
-		const auto& chunk{ chunks_[index] };
-
 		const auto chunkParent{ getParent(index) };
 
-		for (const auto& [first, second] : neighbourChunks(index))
+		for (const auto& [rowOffset, columnOffset] : Stencil<Metric>::template offsets<true>)
 		{
-			if (std::cmp_greater_equal(first, rows_) || std::cmp_greater_equal(second, columns_)) [[unlikely]]
+			const Integer first{ i + rowOffset };
+			const Integer second{ j + columnOffset };
+
+			if (std::cmp_greater_equal(first, rows_) || std::cmp_greater_equal(second, columns_))
 				continue;
 
 			const Integer temp{ first * columns_ + second };
@@ -284,11 +721,12 @@ void SpatialStruct::visitChunk(const Integer index)
 	}
 	else
 	{
-		const auto& chunk{ chunks_[index] };
-
-		for (const auto& [first, second] : neighbourChunks<'P'>(index))
+		for (const auto& [rowOffset, columnOffset] : Stencil<Metric>::template offsets<false>)
 		{
-			if (std::cmp_greater_equal(first, rows_) || std::cmp_greater_equal(second, columns_)) [[unlikely]]
+			const Integer first{ i + rowOffset };
+			const Integer second{ j + columnOffset };
+
+			if (std::cmp_greater_equal(first, rows_) || std::cmp_greater_equal(second, columns_))
 				continue;
 
 			const Integer temp{ first * columns_ + second };
@@ -308,10 +746,15 @@ void SpatialStruct::visitChunk(const Integer index)
 	}
 }
 
+template<class Metric>
 template<char Execution>
-void SpatialStruct::chunkedSpaceMethod(void)
+void SpatialStruct<Metric>::chunkedSpaceMethod(void)
 {
 	const Integer numberOfChunks{ static_cast<Integer>(chunkParents_.size()) };
+	const Integer firstChunk{ mergedRows_ * columns_ };
+
+	if (mergedRows_)
+		printMessage(std::format("Rows already merged: {}", formatNumber(mergedRows_)));
 
 	auto chunkTraverseLambda = [this](const Integer fromIndex, const Integer toIndex)
 	{
@@ -321,7 +764,7 @@ void SpatialStruct::chunkedSpaceMethod(void)
 	};
 
 	if (Execution == 'S')
-		chunkTraverseLambda(0, numberOfChunks);
+		chunkTraverseLambda(firstChunk, numberOfChunks);
 	else
 	{
 		{
@@ -330,10 +773,11 @@ void SpatialStruct::chunkedSpaceMethod(void)
 			std::vector<std::jthread> threadPool;
 			threadPool.reserve(availableThreads);
 
-			const auto chunksPerThread = rows_ * columns_ / availableThreads;
+			const auto chunksPerThread = (numberOfChunks - firstChunk) / availableThreads;
 
 			for (Integer index{ availableThreads }; index--;)
-				threadPool.emplace_back(chunkTraverseLambda, index * chunksPerThread, (index + 1) * chunksPerThread - 1);
+				threadPool.emplace_back(chunkTraverseLambda, firstChunk + index * chunksPerThread,
+										index + 1 == availableThreads ? numberOfChunks : firstChunk + (index + 1) * chunksPerThread);
 		}
 	}
 
@@ -348,8 +792,7 @@ void SpatialStruct::chunkedSpaceMethod(void)
 
 			clusters_ += (*chunkParent == index);
 
-			if (Execution == 'P')
-				*chunkParent = getParent(*chunkParent);
+			*chunkParent = getParent(*chunkParent);
 
 			++sum;
 		}
@@ -358,19 +801,191 @@ void SpatialStruct::chunkedSpaceMethod(void)
 	printMessage(std::format("Empty Chunks are: {} % of total.", formatNumber(100.0 * (numberOfChunks - sum) / numberOfChunks)));
 }
 
-std::set<std::set<Integer>> SpatialStruct::getClusters(void) const
+template<class Metric>
+void SpatialStruct<Metric>::compareLeaves(const TreeNode& A, const TreeNode& B)
+{
+	const bool same{ &A == &B };
+
+	/*
+	 * The links are first found on a local union find over the (at most 2 * leafSize_) points of both leaves,
+	 * so the shared one is locked once, for a few unions.
+	 */
+	const Integer sizeA{ A.end - A.begin };
+	const Integer size{ same ? sizeA : sizeA + B.end - B.begin };
+
+	alignas(64) double xs[2 * leafSize_];
+	alignas(64) double ys[2 * leafSize_];
+	Integer local[2 * leafSize_];
+
+	auto position = [&](const Integer index) { return index < sizeA ? A.begin + index : B.begin + index - sizeA; };
+
+	auto find = [&local](Integer index)
+	{
+		while (local[index] != index)
+			index = local[index] = local[local[index]];
+
+		return index;
+	};
+
+	for (Integer index{ 0 }; index < size; ++index)
+	{
+		const auto& point{ Points_[indices_[position(index)]] };
+
+		xs[index] = point.x();
+		ys[index] = point.y();
+		local[index] = index < sizeA ? (A.whole ? 0 : index) : (B.whole ? sizeA : index);
+	}
+
+	for (Integer i{ 0 }; i < sizeA; ++i)
+	{
+		for (Integer j{ same ? i + 1 : sizeA }; j < size; ++j)
+		{
+			const auto rootI{ find(i) };
+			const auto rootJ{ find(j) };
+
+			if (rootI != rootJ && Metric::within(xs[j] - xs[i], ys[j] - ys[i], distanceThreshold_))
+				local[rootJ] = rootI;
+		}
+	}
+
+	std::lock_guard lock(chunkParentMutex_);
+
+	for (Integer index{ 0 }; index < size; ++index)
+		if (const auto root{ find(index) }; root != index)
+			parents_[getParent<'X'>(position(index))] = getParent<'X'>(position(root));
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::traverseTree(const Integer a, const Integer b, std::vector<std::pair<Integer, Integer>>* pairs)
+{
+	/* With pairs, the node pairs of the next level are collected instead of visited, to be shared by the threads. */
+	auto visit = [this, pairs](const Integer first, const Integer second)
+	{
+		if (pairs)
+			pairs->emplace_back(first, second);
+		else
+			traverseTree(first, second);
+	};
+
+	const auto& A{ tree_[a] };
+	const auto& B{ tree_[b] };
+
+	if (A.whole && B.whole && a != b)
+	{
+		std::lock_guard lock(chunkParentMutex_);
+
+		if (getParent<'X'>(A.begin) == getParent<'X'>(B.begin))
+			return;
+	}
+
+	if (a == b)
+	{
+		if (A.whole)
+			return;
+
+		if (A.leaf)
+			compareLeaves(A, A);
+		else
+		{
+			visit(2 * a + 1, 2 * a + 1);
+			visit(2 * a + 2, 2 * a + 2);
+			visit(2 * a + 1, 2 * a + 2);
+		}
+
+		return;
+	}
+
+	const auto xGap{ std::max({ 0.0, B.box.minX - A.box.maxX, A.box.minX - B.box.maxX }) };
+	const auto yGap{ std::max({ 0.0, B.box.minY - A.box.maxY, A.box.minY - B.box.maxY }) };
+
+	if (!Metric::within(xGap, yGap, distanceThreshold_))
+		return;
+
+	const auto xSpan{ std::max(A.box.maxX, B.box.maxX) - std::min(A.box.minX, B.box.minX) };
+	const auto ySpan{ std::max(A.box.maxY, B.box.maxY) - std::min(A.box.minY, B.box.minY) };
+
+	/* Every point of A is within scale of every point of B. */
+	if (Metric::within(xSpan, ySpan, distanceThreshold_))
+	{
+		std::lock_guard lock(chunkParentMutex_);
+		parents_[getParent<'X'>(B.begin)] = getParent<'X'>(A.begin);
+		return;
+	}
+
+	if (A.leaf && B.leaf)
+		compareLeaves(A, B);
+	else if (B.leaf || (!A.leaf && A.end - A.begin >= B.end - B.begin))
+	{
+		visit(2 * a + 1, b);
+		visit(2 * a + 2, b);
+	}
+	else
+	{
+		visit(a, 2 * b + 1);
+		visit(a, 2 * b + 2);
+	}
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::adaptiveTreeMethod(void)
+{
+	/* The top of the dual tree traversal is unrolled until every thread has a few node pairs. */
+	std::vector<std::pair<Integer, Integer>> pairs{ { 0, 0 } };
+
+	for (std::size_t size{ 0 }; pairs.size() != size && pairs.size() < 16 * availableThreads;)
+	{
+		size = pairs.size();
+
+		std::vector<std::pair<Integer, Integer>> nextPairs;
+
+		for (const auto& [a, b] : pairs)
+			traverseTree(a, b, &nextPairs);
+
+		pairs = std::move(nextPairs);
+	}
+
+	printMessage(std::format("Using {} threads...", formatNumber(availableThreads)));
+
+	auto threadLambda = [&](const Integer k)
+	{
+		for (Integer index{ k }; index < pairs.size(); index += availableThreads)
+			traverseTree(pairs[index].first, pairs[index].second);
+	};
+
+	{
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(availableThreads);
+
+		for (Integer index{ availableThreads }; index--;)
+			threadPool.emplace_back(threadLambda, index);
+	}
+
+	const auto N{ static_cast<Integer>(Points_.size()) };
+
+	clusters_ = 0;
+
+	for (Integer index{ N }; index--;)
+	{
+		clusters_ += (parents_[index] == index);
+
+		parents_[index] = getParent<'X'>(parents_[index]);
+	}
+}
+
+template<class Metric>
+std::set<std::set<Integer>> SpatialStruct<Metric>::getClusters(void) const
 {
 	if (!initialized_ || !clusters_)
 		return {};
 
 	std::unordered_map<Integer, std::set<Integer> > clustersMap;
 
-	if (useChunks_)
+	if (engine_ == Engine::Chunks)
 	{
 		const Integer N{ static_cast<Integer>(chunkParents_.size()) };
 
 		for (Integer i{ N }; i--;)
-			for (const auto& index : chunks_[i])
+			for (const auto& index : chunks_[i].points(indexList_))
 				clustersMap[chunkParents_[i]].insert(index);
 	}
 	else
@@ -389,7 +1004,251 @@ std::set<std::set<Integer>> SpatialStruct::getClusters(void) const
 	return clustersSet;
 }
 
-void SpatialStruct::printClusters(std::ostream& outStream) const
+template<class Metric>
+std::vector<Integer> SpatialStruct<Metric>::getLabels(void) const
+{
+	if (!initialized_ || !clusters_)
+		return {};
+
+	std::vector<Integer> labels(Points_.size(), maxValue);
+
+	if (engine_ == Engine::Chunks)
+	{
+		const Integer N{ static_cast<Integer>(chunkParents_.size()) };
+
+		for (Integer i{ N }; i--;)
+		{
+			if (chunks_[i].isEmpty())
+				continue;
+
+			const auto label{ *chunks_[getParent(i)].points(indexList_).begin() };
+
+			for (const auto& index : chunks_[i].points(indexList_))
+				labels[index] = label;
+		}
+	}
+	else
+	{
+		const Integer N{ static_cast<Integer>(Points_.size()) };
+
+		for (Integer index{ N }; index--;)
+			labels[indices_[index]] = indices_[parents_[index]];
+	}
+
+	return labels;
+}
+
+template<class Metric>
+std::vector<Integer> SpatialStruct<Metric>::sortedByX(void) const
+{
+	std::vector<Integer> order(Points_.size());
+
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(std::execution::par_unseq, order.begin(), order.end(), [this](Integer a, Integer b) { return Points_[a].x() < Points_[b].x(); });
+
+	return order;
+}
+
+template<class Metric>
+template<class Visitor>
+bool SpatialStruct<Metric>::visitNeighbours(const Point& point, const std::vector<Integer>& order, Visitor&& visitor) const
+{
+	const NeighbourGrid grid{ minX_, minY_, chunkLength_, rows_, columns_ };
+
+	return Neighbours::visit<Metric>(point, scale_, engine_ == Engine::Chunks ? &grid : nullptr, order,
+		[this](const Integer index) -> const Point& { return Points_[index]; },
+		[this](const std::uint64_t row, const std::uint64_t column, auto&& visitPoint)
+		{
+			for (const auto index : chunks_[row * columns_ + column].points(indexList_))
+				if (!visitPoint(index))
+					return false;
+
+			return true;
+		},
+		std::forward<Visitor>(visitor));
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::crossMatch(const std::vector<Point>& A, const MatchCallback& callback) const
+{
+	if (!initialized_ || A.empty())
+		return;
+
+	const auto order{ engine_ == Engine::Chunks ? std::vector<Integer>{} : sortedByX() };
+	const auto N{ static_cast<Integer>(A.size()) };
+	const auto batches{ (N + crossMatchBatch_ - 1) / crossMatchBatch_ };
+
+	std::mutex callbackMutex;
+
+	/* The buffer of a thread is reused by all its batches, so there is no allocation per pair. */
+	auto threadLambda = [&](const Integer k)
+	{
+		std::vector<MatchPair> buffer;
+
+		for (Integer batch{ k }; batch < batches; batch += availableThreads)
+		{
+			buffer.clear();
+
+			for (Integer index{ batch * crossMatchBatch_ }; index < std::min(N, (batch + 1) * crossMatchBatch_); ++index)
+				visitNeighbours(A[index], order, [&buffer, index](const Integer b) { buffer.push_back({ index, b }); return true; });
+
+			if (buffer.empty())
+				continue;
+
+			std::lock_guard lock(callbackMutex);
+			callback(buffer);
+		}
+	};
+
+	printMessage(std::format("Cross match of {} points, using {} threads...", formatNumber(N), formatNumber(availableThreads)));
+
+	std::vector<std::jthread> threadPool;
+	threadPool.reserve(availableThreads);
+
+	for (Integer index{ availableThreads }; index--;)
+		threadPool.emplace_back(threadLambda, index);
+}
+
+template<class Metric>
+std::vector<MatchPair> SpatialStruct<Metric>::crossMatch(const std::vector<Point>& A) const
+{
+	std::vector<MatchPair> pairs;
+
+	crossMatch(A, [&pairs](std::span<const MatchPair> batch) { pairs.insert(pairs.end(), batch.begin(), batch.end()); });
+
+	return pairs;
+}
+
+template<class Metric>
+std::vector<Integer> SpatialStruct<Metric>::crossMatchLabels(const std::vector<Point>& A) const
+{
+	if (!initialized_ || !clusters_)
+		return {};
+
+	const auto labels{ getLabels() };
+	const auto order{ engine_ == Engine::Chunks ? std::vector<Integer>{} : sortedByX() };
+	const auto N{ static_cast<Integer>(A.size()) };
+	const auto batches{ (N + crossMatchBatch_ - 1) / crossMatchBatch_ };
+
+	std::vector<Integer> result(N, maxValue);
+
+	auto threadLambda = [&](const Integer k)
+	{
+		for (Integer batch{ k }; batch < batches; batch += availableThreads)
+			for (Integer index{ batch * crossMatchBatch_ }; index < std::min(N, (batch + 1) * crossMatchBatch_); ++index)
+				visitNeighbours(A[index], order, [&](const Integer b) { result[index] = labels[b]; return false; });
+	};
+
+	{
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(availableThreads);
+
+		for (Integer index{ availableThreads }; index--;)
+			threadPool.emplace_back(threadLambda, index);
+	}
+
+	return result;
+}
+
+template<class Metric>
+bool SpatialStruct<Metric>::save(const std::string& path) const
+{
+	if (!initialized_ || !clusters_ || Points_.size() >= std::numeric_limits<std::uint32_t>::max())
+	{
+		std::cout << "\nClusters weren't computed, or point set is too big for a snapshot. Snapshot wasn't saved...\n";
+		return false;
+	}
+
+	const auto N{ static_cast<Integer>(Points_.size()) };
+	const auto pointLabels{ getLabels() };
+
+	std::vector<std::uint32_t> labels(pointLabels.cbegin(), pointLabels.cend());
+	std::vector<std::uint32_t> order;
+	std::vector<std::uint64_t> cellKeys;
+	std::vector<std::uint32_t> cellStarts;
+
+	order.reserve(N);
+
+	if (engine_ == Engine::Chunks)
+	{
+		for (Integer index{ 0 }; index < chunks_.size(); ++index)
+		{
+			if (chunks_[index].isEmpty())
+				continue;
+
+			cellKeys.push_back(index);
+			cellStarts.push_back(static_cast<std::uint32_t>(order.size()));
+
+			for (const auto pointIndex : chunks_[index].points(indexList_))
+				order.push_back(static_cast<std::uint32_t>(pointIndex));
+		}
+
+		cellStarts.push_back(static_cast<std::uint32_t>(order.size()));
+	}
+	else
+	{
+		order.resize(N);
+		std::iota(order.begin(), order.end(), 0U);
+		std::sort(std::execution::par_unseq, order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) { return Points_[a].x() < Points_[b].x(); });
+	}
+
+	auto align = [](const std::uint64_t offset) { return (offset + 63) / 64 * 64; };
+
+	SnapshotHeader header{};
+	std::copy(std::begin(SnapshotHeader::expectedMagic), std::end(SnapshotHeader::expectedMagic), header.magic);
+	header.metric = Metric::id;
+	header.engine = engine_;
+	header.points = N;
+	header.clusters = clusters_;
+	header.cells = cellKeys.size();
+	header.rows = rows_;
+	header.columns = columns_;
+	header.scale = scale_;
+	header.chunkLength = chunkLength_;
+	header.bounds = { minX_, maxX_, minY_, maxY_ };
+	header.pointsOffset = align(sizeof(SnapshotHeader));
+	header.labelsOffset = align(header.pointsOffset + N * sizeof(Point));
+	header.orderOffset = align(header.labelsOffset + N * sizeof(std::uint32_t));
+	header.cellKeysOffset = align(header.orderOffset + N * sizeof(std::uint32_t));
+	header.cellStartsOffset = align(header.cellKeysOffset + cellKeys.size() * sizeof(std::uint64_t));
+	header.fileSize = header.cellStartsOffset + cellStarts.size() * sizeof(std::uint32_t);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+	auto writeSection = [&out](const std::uint64_t offset, const void* data, const std::size_t bytes)
+	{
+		static constexpr char padding[64]{};
+
+		out.write(padding, static_cast<std::streamsize>(offset - static_cast<std::uint64_t>(out.tellp())));
+		out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+	};
+
+	writeSection(0, &header, sizeof(header));
+	writeSection(header.pointsOffset, Points_.data(), N * sizeof(Point));
+	writeSection(header.labelsOffset, labels.data(), labels.size() * sizeof(std::uint32_t));
+	writeSection(header.orderOffset, order.data(), order.size() * sizeof(std::uint32_t));
+	writeSection(header.cellKeysOffset, cellKeys.data(), cellKeys.size() * sizeof(std::uint64_t));
+	writeSection(header.cellStartsOffset, cellStarts.data(), cellStarts.size() * sizeof(std::uint32_t));
+
+	if (!out.good())
+	{
+		std::cout << std::format("\nWriting {} failed. Snapshot wasn't saved...\n", path);
+		return false;
+	}
+
+	printMessage(std::format("Snapshot of {} points was saved to {}.", formatNumber(N), path));
+
+	return true;
+}
+
+template<class Metric>
+SpatialSnapshot<Metric> SpatialStruct<Metric>::open(const std::string& path)
+{
+	return SpatialSnapshot<Metric>(path);
+}
+
+template<class Metric>
+void SpatialStruct<Metric>::printClusters(std::ostream& outStream) const
 {
 	const auto& clusters{ getClusters() };
 
@@ -402,13 +1261,14 @@ void SpatialStruct::printClusters(std::ostream& outStream) const
 	}
 }
 
+template<class Metric>
 template<bool byX>
-void SpatialStruct::axisConnectedComponents(std::mutex& firstMutex, bool& stopThread, bool& firstIsX)
+void SpatialStruct<Metric>::axisConnectedComponents(std::mutex& firstMutex, bool& stopThread, bool& firstIsX)
 {
 	const auto N{ static_cast<Integer>(Points_.size()) };
 	const auto constScale{ scale_ };
 	const auto minusConstScale{ -scale_ };
-	const auto constScaleSquared{ scaleSquared_ };
+	const auto constThreshold{ distanceThreshold_ };
 
 	auto* indicesPtr{ &indices_ };
 	auto* parentsPtr{ &parents_ };
@@ -425,8 +1285,8 @@ void SpatialStruct::axisConnectedComponents(std::mutex& firstMutex, bool& stopTh
 	indicesRef.resize(N);
 	parentsRef.resize(N);
 
-	std::iota(parentsRef.begin(), parentsRef.end(), 0);
-	std::iota(indicesRef.begin(), indicesRef.end(), 0);
+	parallelIota(parentsRef);
+	parallelIota(indicesRef);
 
 	if (byX)
 		std::sort(std::execution::par_unseq, indicesRef.begin(), indicesRef.end(), [&](Integer a, Integer b) { return Points_[a] < Points_[b]; });
@@ -447,14 +1307,14 @@ void SpatialStruct::axisConnectedComponents(std::mutex& firstMutex, bool& stopTh
 
 				if (byX)
 				{
-					const long double xd{ indexJPoint.x() - indexIPoint.x() };
+					const double xd{ indexJPoint.x() - indexIPoint.x() };
 
 					if (xd > constScale)
 						break;
 
-					const long double yd{ indexJPoint.y() - indexIPoint.y() };
+					const double yd{ indexJPoint.y() - indexIPoint.y() };
 
-					if (minusConstScale <= yd && yd <= constScale && xd * xd + yd * yd <= constScaleSquared)
+					if (minusConstScale <= yd && yd <= constScale && Metric::within(xd, yd, constThreshold))
 					{
 						parentsMutex.lock();
 						parentsRef[getParent<'X'>(j)] = getParent<'X'>(i);
@@ -463,14 +1323,14 @@ void SpatialStruct::axisConnectedComponents(std::mutex& firstMutex, bool& stopTh
 				}
 				else
 				{
-					const long double yd{ indexJPoint.y() - indexIPoint.y() };
+					const double yd{ indexJPoint.y() - indexIPoint.y() };
 
 					if (yd > constScale)
 						break;
 
-					const long double xd{ indexJPoint.x() - indexIPoint.x() };
+					const double xd{ indexJPoint.x() - indexIPoint.x() };
 
-					if (minusConstScale <= xd && xd <= constScale && xd * xd + yd * yd <= constScaleSquared)
+					if (minusConstScale <= xd && xd <= constScale && Metric::within(xd, yd, constThreshold))
 					{
 						parentsMutex.lock();
 						parentsRef[getParent<'Y'>(j)] = getParent<'Y'>(i);
@@ -514,7 +1374,8 @@ void SpatialStruct::axisConnectedComponents(std::mutex& firstMutex, bool& stopTh
 	}
 }
 
-void SpatialStruct::connectedComponentsMethod(const bool byXY)
+template<class Metric>
+void SpatialStruct<Metric>::connectedComponentsMethod(const bool byXY)
 {
 	bool firstIsX{ true };
 	bool stopThread{ false };
@@ -551,4 +1412,8 @@ void SpatialStruct::connectedComponentsMethod(const bool byXY)
 		std::copy(std::execution::par_unseq, indicesY_.begin(), indicesY_.end(), indices_.begin());
 		std::copy(std::execution::par_unseq, parentsY_.begin(), parentsY_.end(), parents_.begin());
 	}
-}
\ No newline at end of file
+}
+
+template class SpatialStruct<Euclidean>;
+template class SpatialStruct<Chebyshev>;
+template class SpatialStruct<Manhattan>;
\ No newline at end of file
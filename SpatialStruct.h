@@ -1,9 +1,13 @@
 #pragma once
 
 #include <set>
+#include <span>
+#include <string>
+#include <functional>
 
 #include "Point.h"
 #include "Chunk.h"
+#include "Metric.h"
 
 /*
  * We can increase maxPointValue to DOUBLE_MAX,
@@ -20,6 +24,54 @@ constexpr double maxPointValue = 1.0e100;
 constexpr double minPointValue = -maxPointValue;
 constexpr double THRESHOLD = 4.0e9; // <--- change it based on your available RAM
 
+enum class Engine : std::uint32_t
+{
+	Chunks,
+	ConnectedComponents,
+	Adaptive
+};
+
+struct Bounds
+{
+	double minX{ maxPointValue };
+	double maxX{ minPointValue };
+	double minY{ maxPointValue };
+	double maxY{ minPointValue };
+};
+
+/*
+ * Result of SpatialStruct::estimateClusters.
+ * [lower, upper] holds the cluster count with the requested confidence.
+ * Components bigger than the search cap are counted as one in estimate,
+ * biasBound is the most they can add to it (it's included in upper).
+ * So the estimate is within a few percent when biasBound is small next to it.
+ * It isn't near the percolation scale, where many components have about as many cells as the cap:
+ * there (scale 1.0 of a reviewed run) the estimate was 3 - 7.5% too low, and [lower, upper] was [5081, 28314] for 7204 clusters.
+ */
+struct ClusterEstimate
+{
+	double estimate{ 0.0 };
+	double lower{ 0.0 };
+	double upper{ 0.0 };
+	double biasBound{ 0.0 };
+	Integer samples{ 0 };
+	bool exact{ false };
+};
+
+/* A pair of the cross match: index of the point in the streamed catalog, and in the structure. */
+struct MatchPair
+{
+	Integer a{ 0 };
+	Integer b{ 0 };
+};
+
+using MatchCallback = std::function<void(std::span<const MatchPair>)>;
+
+template<class Metric>
+class SpatialSnapshot;
+
+/* Metric is one of the policies of Metric.h, it fixes the chunk size, the stencil and the distance test at compile time. */
+template<class Metric = Euclidean>
 class SpatialStruct
 {
 public:
@@ -28,14 +80,83 @@ public:
 
 	SpatialStruct(const std::vector<Point>&& data, const double scale) = delete;
 
+	/*
+	 * Engine::Adaptive builds a k-d tree instead of the grid, for heavily skewed densities,
+	 * Engine::ConnectedComponents skips the grid, and Engine::Chunks keeps the automatic choice.
+	 */
+	SpatialStruct(std::vector<Point>& data, const double scale, const Engine engine, const bool verbose = true);
+
+	/*
+	 * Streaming construction: the grid is laid over the given bounds,
+	 * and the (already allocated) points of data are added later with insertPoints.
+	 */
+	SpatialStruct(std::vector<Point>& data, const double scale, const Bounds& bounds, const bool verbose = true);
+
+	/* Minimum and maximum of both axis in a single parallel pass. */
+	static Bounds computeBounds(const std::vector<Point>& data);
+
+	void insertPoints(const Integer fromIndex, const Integer toIndex);
+
+	/* Merges the rows that can't get new neighbours, if no more points with y lower than the given one will be inserted. */
+	void mergeBelow(const double y);
+
+	/* Forgets the merged rows, when points were inserted in them after all. */
+	void restartMerge(void) noexcept;
+
 	Integer computeClusters(const bool byXY = true);
 
+	/*
+	 * Approximate number of clusters, from a capped search of the cell graph around sampled points,
+	 * without changing the structure (computeClusters still gives the exact count afterwards).
+	 * The cells are the chunks, or with Engine::ConnectedComponents, cells of the same size hashed in two passes over the points
+	 * (12 more bytes per point, less than the exact connected components).
+	 * It searches up to samples * 64 cells whatever the number of points, and most searches get there near the percolation scale,
+	 * where it took 71 - 75% of the exact time in the same run (see ClusterEstimate), so it pays off away from it.
+	 * With Engine::Adaptive, with clusters already computed, or with samples >= points, it's the exact count. Samples are at least 1.
+	 */
+	ClusterEstimate estimateClusters(const Integer samples = 10'000, const double confidence = 0.95, const std::uint64_t seed = 0);
+
 	void printClusters(std::ostream& outStream = std::cout) const;
 
 	std::set<std::set<Integer>> getClusters(void) const;
 
+	/* Label of every input point (the index of a point of its cluster), or empty if nothing was computed. */
+	std::vector<Integer> getLabels(void) const;
+
+	/*
+	 * Radius join of another catalog against the points of this structure, which needs no computeClusters.
+	 * The points of A are streamed through the chunks (or an x sorted order without chunks) in parallel batches,
+	 * and the pairs of every batch are handed to callback, one batch at a time.
+	 */
+	void crossMatch(const std::vector<Point>& A, const MatchCallback& callback) const;
+
+	/* All the pairs of the cross match, in a single buffer. */
+	std::vector<MatchPair> crossMatch(const std::vector<Point>& A) const;
+
+	/* For every point of A, the label (see getLabels) of a cluster it touches, or maxValue. Needs computeClusters. */
+	std::vector<Integer> crossMatchLabels(const std::vector<Point>& A) const;
+
+	/* Writes the computed structure to a snapshot file (see Snapshot.h). */
+	bool save(const std::string& path) const;
+
+	/* Maps a snapshot written by save, without parsing it. Check isOpen() of the result. */
+	static SpatialSnapshot<Metric> open(const std::string& path);
+
 private:
 
+	/*
+	 * Node of the adaptive k-d tree, children of node i are 2i + 1 and 2i + 2.
+	 * A whole node has a diameter not bigger than scale, so its points are a single component.
+	 */
+	struct TreeNode
+	{
+		Bounds box{};
+		Integer begin{ 0 };
+		Integer end{ 0 };
+		bool leaf{ false };
+		bool whole{ false };
+	};
+
 /* Methods */
 
 	void printMessage(const std::string_view message) const;
@@ -43,14 +164,30 @@ private:
 	template<char parent = 'C'>
 	inline Integer getParent(const Integer x) const noexcept;
 
-	void initialize(const std::vector<Point>& data, const double scale);
+	bool initialize(const std::vector<Point>& data, const double scale);
+
+	bool initializeGrid(const Bounds& bounds, const double scale);
+
+	bool initializeTree(const Bounds& bounds);
 
-	bool checkDistance(const Point& A, const Point& B) const noexcept;
+	void buildTree(const Integer node, const Integer begin, const Integer end, const Integer depth);
+
+	void compareLeaves(const TreeNode& A, const TreeNode& B);
+
+	void traverseTree(const Integer a, const Integer b, std::vector<std::pair<Integer, Integer>>* pairs = nullptr);
+
+	void adaptiveTreeMethod(void);
+
+	std::vector<Integer> sortedByX(void) const;
+
+	template<class Visitor>
+	bool visitNeighbours(const Point& point, const std::vector<Integer>& order, Visitor&& visitor) const;
 
 	bool compareChunkPoints(const Chunk& A, const Chunk& B) const noexcept;
 
-	template<char Execution = 'S'>
-	std::vector<std::pair<Integer, Integer>> neighbourChunks(const Integer index) const;
+	/* Whether any point of A is within scale of any point of B, both ranges of point indices. */
+	template<class RangeA, class RangeB>
+	bool comparePoints(const RangeA& A, const RangeB& B) const noexcept;
 
 	template<char Execution = 'S'>
 	void visitChunk(const Integer index);
@@ -67,33 +204,42 @@ private:
 
 	bool printMessages_{ true };
 	bool initialized_{ false };
-	bool useChunks_{ false };
 
 	double minX_{ maxPointValue };
 	double maxX_{ minPointValue };
 	double minY_{ maxPointValue };
 	double maxY_{ minPointValue };
 	double scale_{ 0.0 };
+	double chunkLength_{ 0.0 };
 	double minusScale_{ 0.0 };
-	long double scaleSquared_{ 0.0 };
+	double distanceThreshold_{ 0.0 };
 
 	Integer rows_{ 0 };
 	Integer columns_{ 0 };
 	Integer columnsMinusOne_{ 0 };
 	Integer rowsMinusOne_{ 0 };
 	Integer clusters_{ 0 };
+	Integer mergedRows_{ 0 };
+
+	Engine engine_{ Engine::ConnectedComponents };
 
 	static inline const double threshold_{ THRESHOLD };
+	static constexpr Integer leafSize_{ 32 };
+	static constexpr Integer crossMatchBatch_{ 4096 };
+	static constexpr Integer estimateCellCap_{ 64 };
 	std::vector<Point>& Points_;
 
-	std::vector<Integer> indices_;
-	std::vector<Integer> parents_;
-	std::vector<Integer> indicesY_;
-	std::vector<Integer> parentsY_;
+	HugeVector<Integer> indices_;
+	HugeVector<Integer> parents_;
+	HugeVector<Integer> indicesY_;
+	HugeVector<Integer> parentsY_;
+
+	HugeVector<Chunk> chunks_;
+	HugeVector<Integer> indexList_;
+	HugeVector<Integer> chunkParents_;
 
-	std::vector<Chunk> chunks_;
-	std::vector<Integer> indexList_;
-	std::vector<Integer> chunkParents_;
+	std::vector<TreeNode> tree_;
 
+	/* Guards chunkParents_, and parents_ in the adaptive engine. */
 	std::mutex chunkParentMutex_;
 };
\ No newline at end of file
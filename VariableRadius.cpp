@@ -0,0 +1,387 @@
+#define _USE_MATH_DEFINES
+
+#include <unordered_map>
+#include <execution>
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+#include "VariableRadius.h"
+#include "SpatialStruct.h"
+
+static const auto availableThreads = std::max(std::jthread::hardware_concurrency() / 2, 1U);
+
+/* Bigger classes than this would need more than 2^63 cells along the bounding box anyway. */
+constexpr int maxLevels{ 64 };
+
+VariableRadiusStruct::VariableRadiusStruct(std::vector<Point>& data, std::vector<double>& radii, const LinkRule rule, const bool verbose) :
+	printMessages_{ verbose }, rule_{ rule }, Points_{ data }, Radii_{ radii }
+{
+	if (!data.size() || data.size() >= maxValue || data.size() != radii.size() ||
+		!std::all_of(std::execution::par_unseq, radii.cbegin(), radii.cend(), [](const double r) { return r > 0.0 && std::isfinite(r * r); }))
+	{
+		std::cout << "\nRadii are not positive or are too big, or point set is empty, too big, or has not a radius per point. Structure wasn't created...\n";
+		return;
+	}
+
+	initialized_ = initialize();
+}
+
+void VariableRadiusStruct::printMessage(const std::string_view message) const
+{
+	if (printMessages_)
+		std::cout << "\n" << message << "\n";
+}
+
+inline Integer VariableRadiusStruct::getParent(const Integer x) const noexcept
+{
+	Integer localX{ x };
+
+	while (cellParents_[localX] != localX)
+		localX = cellParents_[localX];
+
+	return localX;
+}
+
+template<LinkRule Rule>
+constexpr double VariableRadiusStruct::link(const double a, const double b) noexcept
+{
+	if constexpr (Rule == LinkRule::Sum)
+		return a + b;
+	else
+		return std::max(a, b);
+}
+
+bool VariableRadiusStruct::initialize(void)
+{
+	const auto bounds{ SpatialStruct<>::computeBounds(Points_) };
+	const auto [minRP, maxRP] = std::minmax_element(std::execution::par_unseq, Radii_.cbegin(), Radii_.cend());
+
+	minX_ = bounds.minX;
+	maxX_ = bounds.maxX;
+	minY_ = bounds.minY;
+	maxY_ = bounds.maxY;
+	minRadius_ = *minRP;
+
+	if (!std::isfinite(std::pow(maxX_ - minX_, 2) + std::pow(maxY_ - minY_, 2)))
+	{
+		std::cout << "\nNumber range is too big. Result may be incorrect. Structure wasn't created...\n";
+		return false;
+	}
+
+	auto classOf = [this](const double radius)
+	{
+		auto level{ std::clamp(static_cast<int>(std::floor(std::log2(radius / minRadius_))), 0, maxLevels - 1) };
+
+		level -= level > 0 && radius < std::ldexp(minRadius_, level);
+		level += level + 1 < maxLevels && radius >= std::ldexp(minRadius_, level + 1);
+
+		return level;
+	};
+
+	const auto numberOfLevels{ classOf(*maxRP) + 1 };
+
+	/* The smallest link inside a class is the cell diagonal, the largest one bounds the same level search. */
+	const auto minLink{ rule_ == LinkRule::Sum ? 2.0 : 1.0 };
+	const auto maxLink{ rule_ == LinkRule::Sum ? 4.0 : 2.0 };
+
+	levels_.resize(numberOfLevels);
+
+	for (int level{ 0 }; level < numberOfLevels; ++level)
+	{
+		auto& current{ levels_[level] };
+
+		current.lowerRadius = std::ldexp(minRadius_, level);
+		current.side = minLink * current.lowerRadius / M_SQRT2;
+
+		const auto rows{ std::floor((maxY_ - minY_) / current.side) + 1.0 };
+		const auto columns{ std::floor((maxX_ - minX_) / current.side) + 1.0 };
+
+		if (rows * columns >= 9.0e18)
+		{
+			std::cout << "\nNumber range is too big for the smallest radius. Structure wasn't created...\n";
+			return false;
+		}
+
+		current.rows = static_cast<std::uint64_t>(rows);
+		current.columns = static_cast<std::uint64_t>(columns);
+	}
+
+	const auto reach{ static_cast<int>(std::ceil(maxLink / minLink * M_SQRT2)) };
+	const auto reachSquared{ maxLink * maxLink / (minLink * minLink / 2.0) };
+
+	for (int row{ 0 }; row <= reach; ++row)
+		for (int column{ -reach }; column <= reach; ++column)
+		{
+			const auto rowGap{ std::max(row - 1, 0) };
+			const auto columnGap{ std::max(std::abs(column) - 1, 0) };
+
+			if ((row > 0 || column > 0) && rowGap * rowGap + columnGap * columnGap < reachSquared)
+				stencil_.emplace_back(row, column);
+		}
+
+	std::vector<std::vector<std::pair<std::uint64_t, Integer>>> levelPoints(numberOfLevels);
+
+	for (Integer index{ 0 }; index < Points_.size(); ++index)
+	{
+		const auto levelIndex{ classOf(Radii_[index]) };
+		const auto& level{ levels_[levelIndex] };
+		const auto& point{ Points_[index] };
+
+		const auto row{ std::min(static_cast<std::uint64_t>((point.y() - minY_) / level.side), level.rows - 1) };
+		const auto column{ std::min(static_cast<std::uint64_t>((point.x() - minX_) / level.side), level.columns - 1) };
+
+		levelPoints[levelIndex].emplace_back(row * level.columns + column, index);
+	}
+
+	Integer numberOfCells{ 0 };
+
+	for (int level{ 0 }; level < numberOfLevels; ++level)
+	{
+		auto& current{ levels_[level] };
+		auto& pairs{ levelPoints[level] };
+
+		std::sort(std::execution::par_unseq, pairs.begin(), pairs.end());
+
+		current.firstCell = numberOfCells;
+		current.points.reserve(pairs.size());
+
+		for (Integer index{ 0 }; index < pairs.size(); ++index)
+		{
+			if (!index || pairs[index].first != pairs[index - 1].first)
+			{
+				current.keys.push_back(pairs[index].first);
+				current.starts.push_back(index);
+			}
+
+			current.points.push_back(pairs[index].second);
+		}
+
+		current.starts.push_back(static_cast<Integer>(pairs.size()));
+		numberOfCells += static_cast<Integer>(current.keys.size());
+
+		printMessage(std::format("Radius class {}: {} points in {} cells of side {}", level, pairs.size(), current.keys.size(), current.side));
+
+		std::vector<std::pair<std::uint64_t, Integer>>().swap(pairs);
+	}
+
+	cellParents_.resize(numberOfCells);
+	std::iota(cellParents_.begin(), cellParents_.end(), 0U);
+
+	cellPoints_.resize(numberOfCells);
+
+	for (const auto& level : levels_)
+		for (Integer cell{ 0 }; cell < level.keys.size(); ++cell)
+			cellPoints_[level.firstCell + cell] = level.points[level.starts[cell]];
+
+	printMessage(std::format("Structure was created for {} points in {} radius classes.", Points_.size(), numberOfLevels));
+
+	return true;
+}
+
+Integer VariableRadiusStruct::findCell(const Level& level, const std::uint64_t row, const std::uint64_t column) const noexcept
+{
+	if (row >= level.rows || column >= level.columns)
+		return maxValue;
+
+	const auto key{ row * level.columns + column };
+	const auto position{ std::lower_bound(level.keys.cbegin(), level.keys.cend(), key) };
+
+	if (position == level.keys.cend() || *position != key)
+		return maxValue;
+
+	return static_cast<Integer>(position - level.keys.cbegin());
+}
+
+template<LinkRule Rule>
+bool VariableRadiusStruct::compareCells(const Level& A, const Integer a, const Level& B, const Integer b) const noexcept
+{
+	constexpr Integer batchSize{ 64 };
+
+	alignas(64) double xs[batchSize];
+	alignas(64) double ys[batchSize];
+	alignas(64) double rs[batchSize];
+
+	for (auto batchBegin{ B.starts[b] }; batchBegin < B.starts[b + 1]; batchBegin += batchSize)
+	{
+		const auto size{ std::min(batchSize, B.starts[b + 1] - batchBegin) };
+
+		for (Integer index{ 0 }; index < size; ++index)
+		{
+			const auto pointB{ B.points[batchBegin + index] };
+			xs[index] = Points_[pointB].x();
+			ys[index] = Points_[pointB].y();
+			rs[index] = Radii_[pointB];
+		}
+
+		for (auto indexA{ A.starts[a] }; indexA < A.starts[a + 1]; ++indexA)
+		{
+			const auto pointA{ A.points[indexA] };
+			const auto x{ Points_[pointA].x() };
+			const auto y{ Points_[pointA].y() };
+			const auto r{ Radii_[pointA] };
+
+			bool found{ false };
+
+			for (Integer index{ 0 }; index < size; ++index)
+			{
+				const auto xd{ xs[index] - x };
+				const auto yd{ ys[index] - y };
+				const auto l{ link<Rule>(r, rs[index]) };
+
+				found |= xd * xd + yd * yd <= l * l;
+			}
+
+			if (found)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void VariableRadiusStruct::uniteCells(const Integer a, const Integer b)
+{
+	std::lock_guard lock(cellParentMutex_);
+	cellParents_[getParent(b)] = getParent(a);
+}
+
+template<LinkRule Rule>
+void VariableRadiusStruct::visitCell(const Integer level, const Integer cell)
+{
+	const auto& current{ levels_[level] };
+
+	const auto key{ current.keys[cell] };
+	const auto row{ key / current.columns };
+	const auto column{ key % current.columns };
+
+	/* Negative offsets wrap around, and are skipped by findCell. */
+	for (const auto& [rowOffset, columnOffset] : stencil_)
+	{
+		const auto neighbour{ findCell(current, row + rowOffset, column + columnOffset) };
+
+		if (neighbour != maxValue && compareCells<Rule>(current, cell, current, neighbour))
+			uniteCells(current.firstCell + cell, current.firstCell + neighbour);
+	}
+
+	const auto cellMinX{ minX_ + column * current.side };
+	const auto cellMinY{ minY_ + row * current.side };
+	const auto upperRadius{ 2.0 * current.lowerRadius };
+
+	for (auto coarserLevel{ level + 1 }; coarserLevel < levels_.size(); ++coarserLevel)
+	{
+		const auto& coarser{ levels_[coarserLevel] };
+
+		if (coarser.keys.empty())
+			continue;
+
+		/* Largest link between the two classes, the search is limited to it. */
+		const auto bound{ link<Rule>(upperRadius, 2.0 * coarser.lowerRadius) };
+
+		const auto fromRow{ static_cast<std::uint64_t>(std::max(std::floor((cellMinY - bound - minY_) / coarser.side), 0.0)) };
+		const auto toRow{ std::min(static_cast<std::uint64_t>((cellMinY + current.side + bound - minY_) / coarser.side), coarser.rows - 1) };
+		const auto fromColumn{ static_cast<std::uint64_t>(std::max(std::floor((cellMinX - bound - minX_) / coarser.side), 0.0)) };
+		const auto toColumn{ std::min(static_cast<std::uint64_t>((cellMinX + current.side + bound - minX_) / coarser.side), coarser.columns - 1) };
+
+		for (auto coarserRow{ fromRow }; coarserRow <= toRow; ++coarserRow)
+		{
+			const auto yGap{ std::max({ minY_ + coarserRow * coarser.side - (cellMinY + current.side), cellMinY - (minY_ + (coarserRow + 1) * coarser.side), 0.0 }) };
+
+			for (auto coarserColumn{ fromColumn }; coarserColumn <= toColumn; ++coarserColumn)
+			{
+				const auto xGap{ std::max({ minX_ + coarserColumn * coarser.side - (cellMinX + current.side), cellMinX - (minX_ + (coarserColumn + 1) * coarser.side), 0.0 }) };
+
+				if (xGap * xGap + yGap * yGap > bound * bound)
+					continue;
+
+				const auto neighbour{ findCell(coarser, coarserRow, coarserColumn) };
+
+				if (neighbour != maxValue && compareCells<Rule>(current, cell, coarser, neighbour))
+					uniteCells(current.firstCell + cell, coarser.firstCell + neighbour);
+			}
+		}
+	}
+}
+
+template<LinkRule Rule>
+void VariableRadiusStruct::linkCells(void)
+{
+	printMessage(std::format("Using {} threads...", availableThreads));
+
+	for (Integer level{ 0 }; level < levels_.size(); ++level)
+	{
+		const auto numberOfCells{ static_cast<Integer>(levels_[level].keys.size()) };
+		const auto cellsPerThread{ numberOfCells / availableThreads };
+
+		auto cellTraverseLambda = [this, level](const Integer fromCell, const Integer toCell)
+		{
+			for (Integer cell{ fromCell }; cell < toCell; ++cell)
+				visitCell<Rule>(level, cell);
+		};
+
+		std::vector<std::jthread> threadPool;
+		threadPool.reserve(availableThreads);
+
+		for (Integer index{ availableThreads }; index--;)
+			threadPool.emplace_back(cellTraverseLambda, index * cellsPerThread,
+									index + 1 == availableThreads ? numberOfCells : (index + 1) * cellsPerThread);
+	}
+}
+
+Integer VariableRadiusStruct::computeClusters(void)
+{
+	if (!initialized_)
+		return 0;
+
+	if (clusters_)
+		return clusters_;
+
+	if (rule_ == LinkRule::Sum)
+		linkCells<LinkRule::Sum>();
+	else
+		linkCells<LinkRule::Max>();
+
+	for (Integer index{ static_cast<Integer>(cellParents_.size()) }; index--;)
+	{
+		clusters_ += (cellParents_[index] == index);
+		cellParents_[index] = getParent(cellParents_[index]);
+	}
+
+	return clusters_;
+}
+
+std::vector<Integer> VariableRadiusStruct::getLabels(void) const
+{
+	if (!initialized_ || !clusters_)
+		return {};
+
+	std::vector<Integer> labels(Points_.size(), maxValue);
+
+	for (const auto& level : levels_)
+		for (Integer cell{ 0 }; cell < level.keys.size(); ++cell)
+		{
+			const auto label{ cellPoints_[getParent(level.firstCell + cell)] };
+
+			for (auto index{ level.starts[cell] }; index < level.starts[cell + 1]; ++index)
+				labels[level.points[index]] = label;
+		}
+
+	return labels;
+}
+
+std::set<std::set<Integer>> VariableRadiusStruct::getClusters(void) const
+{
+	const auto labels{ getLabels() };
+
+	std::unordered_map<Integer, std::set<Integer>> clustersMap;
+
+	for (Integer index{ static_cast<Integer>(labels.size()) }; index--;)
+		clustersMap[labels[index]].insert(index);
+
+	std::set<std::set<Integer>> clustersSet;
+
+	for (auto& [first, second] : clustersMap)
+		clustersSet.insert(std::move(second));
+
+	return clustersSet;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <set>
+#include <cstdint>
+
+#include "Point.h"
+#include "Chunk.h"
+
+/*
+ * Clustering with a link radius per point: points i and j are linked
+ * if their Euclidean distance is at most r_i + r_j (Sum) or max(r_i, r_j) (Max).
+ *
+ * Points are bucketed in radius classes, class k holding radii in [minR * 2^k, minR * 2^(k+1)),
+ * and every class gets its own sparse grid level, with cells small enough that all points of a cell
+ * are linked (cell diagonal = smallest link inside the class).
+ * A cell is compared with the cells of its own level inside the largest link of the class,
+ * and with the cells of the coarser levels inside the largest link between the two classes,
+ * so a few big radii never force a coarse grid on the many small ones.
+ */
+
+enum class LinkRule
+{
+	Sum,
+	Max
+};
+
+class VariableRadiusStruct
+{
+public:
+
+	VariableRadiusStruct(std::vector<Point>& data, std::vector<double>& radii, const LinkRule rule, const bool verbose = true);
+
+	VariableRadiusStruct(const std::vector<Point>&& data, const std::vector<double>&& radii, const LinkRule rule) = delete;
+
+	Integer computeClusters(void);
+
+	std::set<std::set<Integer>> getClusters(void) const;
+
+	/* Label of every input point (the index of a point of its cluster), or empty if nothing was computed. */
+	std::vector<Integer> getLabels(void) const;
+
+private:
+
+	struct Level
+	{
+		double side{ 0.0 };
+		double lowerRadius{ 0.0 };
+		std::uint64_t rows{ 0 };
+		std::uint64_t columns{ 0 };
+		Integer firstCell{ 0 };
+
+		/* Sorted keys (row * columns + column) of the non empty cells, and their points. */
+		std::vector<std::uint64_t> keys;
+		std::vector<Integer> starts;
+		std::vector<Integer> points;
+	};
+
+/* Methods */
+
+	void printMessage(const std::string_view message) const;
+
+	bool initialize(void);
+
+	inline Integer getParent(const Integer x) const noexcept;
+
+	Integer findCell(const Level& level, const std::uint64_t row, const std::uint64_t column) const noexcept;
+
+	template<LinkRule Rule>
+	static constexpr double link(const double a, const double b) noexcept;
+
+	template<LinkRule Rule>
+	bool compareCells(const Level& A, const Integer a, const Level& B, const Integer b) const noexcept;
+
+	void uniteCells(const Integer a, const Integer b);
+
+	template<LinkRule Rule>
+	void visitCell(const Integer level, const Integer cell);
+
+	template<LinkRule Rule>
+	void linkCells(void);
+
+/* Fields */
+
+	bool printMessages_{ true };
+	bool initialized_{ false };
+
+	LinkRule rule_{ LinkRule::Sum };
+
+	double minX_{ 0.0 };
+	double minY_{ 0.0 };
+	double maxX_{ 0.0 };
+	double maxY_{ 0.0 };
+	double minRadius_{ 0.0 };
+
+	Integer clusters_{ 0 };
+
+	std::vector<Point>& Points_;
+	std::vector<double>& Radii_;
+
+	std::vector<Level> levels_;
+
+	/* Same level neighbour cells, as (row, column) offsets of the forward half. */
+	std::vector<std::pair<int, int>> stencil_;
+
+	std::vector<Integer> cellParents_;
+	std::vector<Integer> cellPoints_;
+
+	std::mutex cellParentMutex_;
+};
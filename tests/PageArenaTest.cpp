@@ -0,0 +1,59 @@
+#include <format>
+#include <random>
+
+#include "../Clustering.h"
+
+/*
+ * Rebuilds of a structure whose arrays are bigger than 256 MB (the former fixed limit of the arena)
+ * must reuse the blocks freed by the previous build, without mapping new ones.
+ * Exits with 1 if a rebuild maps memory or counts other clusters.
+ */
+
+int main()
+{
+	std::mt19937_64 generator{ 42 };
+	std::uniform_real_distribution distribution(0.0, 1000.0);
+
+	std::vector<Point> points(12'000'000);
+
+	for (auto& point : points)
+		point = { distribution(generator), distribution(generator) };
+
+	constexpr double scale{ 0.4 };
+	constexpr std::size_t formerLimit{ std::size_t{ 1 } << 28 };
+
+	auto& arena{ PageArena::instance() };
+
+	Integer clusters{ 0 };
+	{
+		SpatialStruct<> spatial(points, scale, false);
+		clusters = spatial.computeClusters();
+	}
+
+	const auto mapped{ arena.mappedBytes() };
+
+	bool passed{ true };
+
+	if (mapped <= formerLimit)
+	{
+		std::cout << std::format("\nThe structure maps only {} bytes, not more than the former limit.\n", mapped);
+		passed = false;
+	}
+
+	for (int rebuild{ 0 }; rebuild < 3 && passed; ++rebuild)
+	{
+		SpatialStruct<> spatial(points, scale, false);
+		const auto rebuiltClusters{ spatial.computeClusters() };
+
+		if (rebuiltClusters != clusters || arena.mappedBytes() != mapped)
+		{
+			std::cout << std::format("\nRebuild {}: {} clusters instead of {}, {} bytes mapped instead of {}.\n",
+									 rebuild + 1, rebuiltClusters, clusters, arena.mappedBytes(), mapped);
+			passed = false;
+		}
+	}
+
+	std::cout << (passed ? "\nPage arena test passed.\n" : "\nPage arena test failed.\n");
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+
+#include <unistd.h>
+
+#include "../Clustering.h"
+
+/*
+ * Clusters of point files through Radius2DClustering::pipelinedScaleCluster2DFiles,
+ * with and without bounds, against the in-memory count. Exits with 1 if any of them differs.
+ */
+
+namespace
+{
+	/* Writes the points to temporary files, removed when it goes out of scope. */
+	struct TemporaryFiles
+	{
+		std::vector<std::string> paths;
+
+		TemporaryFiles(const std::vector<Point>& points, const std::size_t files)
+		{
+			const auto directory{ std::filesystem::temp_directory_path() };
+			const auto filePoints{ (points.size() + files - 1) / files };
+
+			for (std::size_t file{ 0 }; file < files; ++file)
+			{
+				paths.push_back((directory / std::format("pipelined_ingest_test_{}_{}.points", ::getpid(), file)).string());
+
+				const auto first{ std::min(points.size(), file * filePoints) };
+				const auto last{ std::min(points.size(), first + filePoints) };
+
+				std::ofstream stream(paths.back(), std::ios::binary);
+				stream.write(reinterpret_cast<const char*>(points.data() + first), static_cast<std::streamsize>((last - first) * sizeof(Point)));
+			}
+		}
+
+		~TemporaryFiles()
+		{
+			for (const auto& path : paths)
+				std::filesystem::remove(path);
+		}
+	};
+
+	bool check(const std::string_view name, const Integer result, const Integer expected)
+	{
+		if (result == expected)
+			return true;
+
+		std::cout << std::format("\n{}: {} clusters instead of {}\n", name, result, expected);
+		return false;
+	}
+}
+
+int main()
+{
+	std::mt19937_64 generator{ 42 };
+	std::uniform_real_distribution distribution(0.0, 1000.0);
+
+	/* More than one block of PipelinedIngest, so strips are merged while the next blocks are read. */
+	std::vector<Point> points(3'000'000);
+
+	for (auto& point : points)
+		point = { distribution(generator), distribution(generator) };
+
+	std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.y() < b.y(); });
+
+	constexpr double scale{ 0.5 };
+	const Bounds bounds{ 0.0, 1000.0, 0.0, 1000.0 };
+
+	const auto expected{ Radius2DClustering::scaleCluster2DPoints(points, scale) };
+
+	bool passed{ true };
+	{
+		const TemporaryFiles files(points, 3);
+
+		passed &= check("Unbounded", Radius2DClustering::pipelinedScaleCluster2DFiles(files.paths, scale), expected);
+		passed &= check("Bounded", Radius2DClustering::pipelinedScaleCluster2DFiles(files.paths, scale, bounds), expected);
+		passed &= check("Bounded and y ordered", Radius2DClustering::pipelinedScaleCluster2DFiles(files.paths, scale, bounds, true), expected);
+
+		/* Points outside of the bounds are rejected. */
+		passed &= check("Too small bounds", Radius2DClustering::pipelinedScaleCluster2DFiles(files.paths, scale, Bounds{ 0.0, 500.0, 0.0, 500.0 }, true), 0);
+	}
+
+	/* Files in the wrong order break the y order, the strips are then merged after the reading. */
+	std::reverse(points.begin(), points.end());
+	{
+		const TemporaryFiles files(points, 3);
+
+		passed &= check("Not y ordered", Radius2DClustering::pipelinedScaleCluster2DFiles(files.paths, scale, bounds, true), expected);
+	}
+
+	std::cout << (passed ? "\nPipelined ingest test passed.\n" : "\nPipelined ingest test failed.\n");
+
+	return passed ? 0 : 1;
+}
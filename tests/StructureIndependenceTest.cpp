@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <random>
+
+#include <unistd.h>
+
+#include "../Clustering.h"
+
+/*
+ * A structure must keep answering right after others are built, each one owns the lists of its chunks.
+ * Cross match, labels and a saved snapshot of a structure are compared before and after another one is built.
+ * Exits with 1 if any of them changed.
+ */
+
+namespace
+{
+	std::vector<Point> randomPoints(const Integer N, const std::uint64_t seed, const double minVal, const double maxVal)
+	{
+		std::mt19937_64 generator{ seed };
+		std::uniform_real_distribution distribution(minVal, maxVal);
+
+		std::vector<Point> Points(N);
+
+		for (auto& point : Points)
+			point = { distribution(generator), distribution(generator) };
+
+		return Points;
+	}
+
+	/* Path of a temporary file, removed when it goes out of scope. */
+	struct TemporaryFile
+	{
+		std::string path{ (std::filesystem::temp_directory_path() / std::format("structure_independence_test_{}.snapshot", ::getpid())).string() };
+
+		~TemporaryFile()
+		{
+			std::filesystem::remove(path);
+		}
+	};
+
+	bool check(const std::string_view name, const bool passed)
+	{
+		if (!passed)
+			std::cout << std::format("\n{} changed after another structure was built.\n", name);
+
+		return passed;
+	}
+}
+
+int main()
+{
+	std::vector<Point> A = randomPoints(2'000, 42, 0.0, 100.0);
+	std::vector<Point> B = randomPoints(5'000, 43, 0.0, 100.0);
+	std::vector<Point> C = randomPoints(50, 44, 0.0, 700.0);
+
+	SpatialStruct<> spatialB(B, 1.0, false);
+	spatialB.computeClusters();
+
+	const auto pairs{ spatialB.crossMatch(A).size() };
+	const auto labels{ spatialB.getLabels() };
+
+	SpatialStruct<> spatialC(C, 0.3, false);
+	spatialC.computeClusters();
+
+	bool passed{ check("Cross match", spatialB.crossMatch(A).size() == pairs) };
+	passed &= check("Labels", spatialB.getLabels() == labels);
+
+	{
+		const TemporaryFile file;
+
+		passed &= check("Saving", spatialB.save(file.path));
+
+		/* The snapshot is closed before its file is removed, which Windows needs. */
+		const auto snapshot{ SpatialStruct<>::open(file.path) };
+		const auto snapshotLabels{ snapshot.labels() };
+
+		passed &= check("Snapshot labels", snapshot.isOpen() && std::equal(labels.cbegin(), labels.cend(), snapshotLabels.begin(), snapshotLabels.end()));
+	}
+
+	std::cout << (passed ? "\nStructure independence test passed.\n" : "\nStructure independence test failed.\n");
+
+	return passed ? 0 : 1;
+}